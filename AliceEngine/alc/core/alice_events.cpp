@@ -0,0 +1,57 @@
+#include "alice_events.hpp"
+
+namespace alc {
+
+	namespace {
+		std::mutex s_channelLock;
+		std::vector<std::unique_ptr<detail::deferred_channel_base>> s_channels;
+
+		std::mutex s_threadLock;
+		size_t s_threadCount = 0;
+		std::vector<size_t> s_freeThreadIndices;
+
+		// gives the index back when the thread exits so the queues dont run out
+		struct thread_index final {
+			size_t value = static_cast<size_t>(-1);
+
+			~thread_index() {
+				if (value == static_cast<size_t>(-1)) return;
+				std::lock_guard<std::mutex> _(s_threadLock);
+				s_freeThreadIndices.push_back(value);
+			}
+		};
+		thread_local thread_index t_threadIndex;
+	}
+
+	void alice_events::__flush() {
+		// listeners may post new event types which registers more channels
+		for (size_t i = 0;; i++) {
+			detail::deferred_channel_base* channel;
+			{
+				std::lock_guard<std::mutex> _(s_channelLock);
+				if (i >= s_channels.size()) break;
+				channel = s_channels[i].get();
+			}
+			channel->flush();
+		}
+	}
+
+	size_t alice_events::__get_thread_index() {
+		if (t_threadIndex.value == static_cast<size_t>(-1)) {
+			std::lock_guard<std::mutex> _(s_threadLock);
+			if (s_freeThreadIndices.size() > 0) {
+				t_threadIndex.value = s_freeThreadIndices.back();
+				s_freeThreadIndices.pop_back();
+			} else {
+				t_threadIndex.value = s_threadCount++;
+			}
+		}
+		return t_threadIndex.value;
+	}
+
+	void alice_events::__register_channel(detail::deferred_channel_base* channel) {
+		std::lock_guard<std::mutex> _(s_channelLock);
+		s_channels.emplace_back(channel);
+	}
+
+}
\ No newline at end of file
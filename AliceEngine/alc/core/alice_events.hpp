@@ -3,9 +3,51 @@
 #include "../common.hpp"
 #include "../datatypes/function.hpp"
 #include "../datatypes/timestep.hpp"
+#include "../datatypes/spsc_queue.hpp"
+#include <atomic>
+#include <iterator>
+#include <mutex>
 
 namespace alc {
 
+	namespace detail {
+
+		// the number of threads that get their own queue for each event type
+		constexpr size_t deferred_queue_count = 64;
+
+		// base of every deferred event type, lets alice_events flush them without knowing the type
+		class deferred_channel_base {
+		public:
+			virtual ~deferred_channel_base() = 0 { }
+			virtual void flush() = 0;
+		};
+
+		// the queues and listeners of a single deferred event type
+		template<typename Ty>
+		class deferred_channel final : public deferred_channel_base {
+		public:
+			~deferred_channel();
+
+			event<void, const Ty&> listeners;
+
+			// called from any thread
+			template<typename T> void post(T&& ev);
+
+			// called on the thread that flushes alice_events
+			void flush() override;
+
+		private:
+			// one queue per thread so posting never takes a lock
+			std::atomic<spsc_queue<Ty>*> m_queues[deferred_queue_count] = { };
+			// threads past the number of queues share a locked list
+			std::mutex m_overflowLock;
+			std::vector<Ty> m_overflow;
+			// events being dispatched, kept to reuse its memory
+			std::vector<Ty> m_batch;
+		};
+
+	}
+
 	// static class holding all the events
 	class alice_events final {
 		ALC_STATIC_CLASS(alice_events);
@@ -14,8 +56,112 @@ namespace alc {
 		// basic update callback
 		static inline event<void, timestep> onUpdate;
 
+		// deferred events
+		// any thread can post an event, events are stored and dispatched on the engine's thread
+		// when the engine flushes, once per frame after updating
+		// events are dispatched grouped by type, in the order they were posted on each thread
+		//     struct damage_event { entity* target; float amount; };
+		//     alice_events::post(damage_event{ target, 10.0f });
+		//     alice_events::subscribe<damage_event>([](const damage_event& ev) { ... });
+
+		// posts an event of type Ty, can be called from any thread
+		template<typename Ty> static void post(Ty&& ev);
+
+		// adds a listener for deferred events of type Ty
+		// must be called from the engine's thread
+		template<typename Ty> static event_token subscribe(const function<void, const Ty&>& listener);
+
+		// removes a listener for deferred events of type Ty
+		// must be called from the engine's thread
+		template<typename Ty> static void unsubscribe(event_token& token);
+
+		// dispatches every posted event
+		static void __flush();
+
+		// the index of the calling thread, used to pick its queue
+		// indices are given back when the thread exits and reused by the next thread
+		static size_t __get_thread_index();
+
+		// takes ownership of the channel
+		static void __register_channel(detail::deferred_channel_base* channel);
+
+	private:
+		template<typename Ty> static detail::deferred_channel<Ty>* get_channel();
 	};
 
+
+	// implementations
+
+	namespace detail {
+
+		template<typename Ty>
+		inline deferred_channel<Ty>::~deferred_channel() {
+			for (auto& queue : m_queues) delete queue.load(std::memory_order_acquire);
+		}
+
+		template<typename Ty>
+		template<typename T>
+		inline void deferred_channel<Ty>::post(T&& ev) {
+			const size_t index = alice_events::__get_thread_index();
+			if (index >= std::size(m_queues)) {
+				std::lock_guard<std::mutex> _(m_overflowLock);
+				m_overflow.emplace_back(std::forward<T>(ev));
+				return;
+			}
+
+			// only this thread ever sets its own queue
+			spsc_queue<Ty>* queue = m_queues[index].load(std::memory_order_relaxed);
+			if (queue == nullptr) {
+				queue = new spsc_queue<Ty>();
+				m_queues[index].store(queue, std::memory_order_release);
+			}
+			queue->emplace(std::forward<T>(ev));
+		}
+
+		template<typename Ty>
+		inline void deferred_channel<Ty>::flush() {
+			// take everything first so events posted by listeners wait for the next flush
+			for (auto& slot : m_queues) {
+				spsc_queue<Ty>* queue = slot.load(std::memory_order_acquire);
+				if (queue) queue->consume([this](Ty&& ev) { m_batch.push_back(std::move(ev)); });
+			}
+			{
+				std::lock_guard<std::mutex> _(m_overflowLock);
+				for (auto& ev : m_overflow) m_batch.push_back(std::move(ev));
+				m_overflow.clear();
+			}
+
+			for (const Ty& ev : m_batch) listeners(ev);
+			m_batch.clear();
+		}
+
+	}
+
+	template<typename Ty>
+	inline detail::deferred_channel<Ty>* alice_events::get_channel() {
+		static detail::deferred_channel<Ty>* channel = [] {
+			auto* c = new detail::deferred_channel<Ty>();
+			__register_channel(c);
+			return c;
+		}();
+		return channel;
+	}
+
+	template<typename Ty>
+	inline void alice_events::post(Ty&& ev) {
+		get_channel<std::decay_t<Ty>>()->post(std::forward<Ty>(ev));
+	}
+
+	template<typename Ty>
+	inline event_token alice_events::subscribe(const function<void, const Ty&>& listener) {
+		return get_channel<Ty>()->listeners.subscribe(listener);
+	}
+
+	template<typename Ty>
+	inline void alice_events::unsubscribe(event_token& token) {
+		get_channel<Ty>()->listeners.unsubscribe(token);
+	}
+
 }
 
 #endif // !ALC_CORE_ALICE_EVENTS_HPP
\ No newline at end of file
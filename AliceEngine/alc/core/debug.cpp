@@ -1,104 +1,250 @@
 #include "debug.hpp"
+#include "../datatypes/spsc_queue.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <thread>
 
 #define LOG_FILE_PATH std::string("Logs/Log_")
-using mutex_guard = std::lock_guard<std::mutex>;
 
-const std::string& alc::debugger::get_log_path() {
-	if (s_logFilepath == "") {
+namespace {
+
+	using clock = std::chrono::steady_clock;
+
+	// callers pass messages that are already built, so a record keeps the string instead of
+	// packing the arguments into bytes, the formatting into text still happens on the writer thread
+	struct log_record final {
+		alc::int64 time; // nanoseconds since the logger started
+		const char* file;
+		alc::uint32 line;
+		alc::uint32 thread;
+		alc::log_level level;
+		std::string message;
+	};
+
+	using record_queue = alc::spsc_queue<log_record, 128>;
+
+	struct logger final {
+		std::mutex lock;
+		std::condition_variable wake;
+		std::condition_variable flushed;
+
+		// every thread that ever logged, never removed so the thread's pointer stays valid
+		std::vector<std::unique_ptr<record_queue>> queues;
+
+		std::thread writer;
+		std::atomic_bool running = false;
+		bool quit = false;
+		// set when an error is queued so the writer doesnt wait for the next batch
+		std::atomic_bool urgent = false;
+		alc::uint64 flushRequested = 0;
+		alc::uint64 flushCompleted = 0;
+
+		const clock::time_point start = clock::now();
+
+		// only used by the writer thread
+		std::string path;
+		std::ofstream file;
+		std::vector<log_record> batch;
+		std::string fileText;
+		std::string consoleText;
+
+		~logger();
+	};
+
+	logger& get_logger() {
+		static logger s_logger;
+		return s_logger;
+	}
+
+	thread_local record_queue* t_queue = nullptr;
+	thread_local alc::uint32 t_threadIndex = 0;
+
+	const char* level_name(alc::log_level level) {
+		switch (level) {
+			case alc::log_level::trace: return "Trace";
+			case alc::log_level::log: return "Log";
+			case alc::log_level::warning: return "Warning";
+			case alc::log_level::error: return "Error";
+			default: return "FatalError";
+		}
+	}
+
+	std::string find_log_path() {
 		// find a unique file name to use
 		size_t i = 0;
-		s_logFilepath = LOG_FILE_PATH + std::to_string(i);
-		std::fstream file(s_logFilepath);
+		std::string path = LOG_FILE_PATH + std::to_string(i);
+		std::fstream file(path);
 		while (file.is_open()) {
 			// try to open a file with name:
 			file.close();
 			++i;
-			s_logFilepath = LOG_FILE_PATH + std::to_string(i);
-			file.open(s_logFilepath);
+			path = LOG_FILE_PATH + std::to_string(i);
+			file.open(path);
 		}
 		file.close();
+		return path;
 	}
-	return s_logFilepath;
-}
 
-void alc::debugger::log(const std::string& msg, const std::string& file, size_t line) {
-	mutex_guard mg(s_lock);
-	// open file at the end
-	std::ofstream filestream;
-	filestream.open(get_log_path(), std::ios::app);
+	// formats and writes everything that is queued
+	void write_records(logger& l, const std::vector<record_queue*>& queues) {
+		for (record_queue* queue : queues) {
+			queue->consume([&l](log_record&& record) { l.batch.push_back(std::move(record)); });
+		}
+		if (l.batch.size() == 0) return;
+
+		// each queue is in order, merge the threads by time
+		std::stable_sort(l.batch.begin(), l.batch.end(), [](const log_record& a, const log_record& b) {
+			return a.time < b.time;
+		});
+
+		for (auto& record : l.batch) {
+			const char* name = level_name(record.level);
+			const std::string time = std::to_string(static_cast<double>(record.time) / 1e9);
+			l.fileText += "[" + time + "][t" + std::to_string(record.thread) + "][" + name
+				+ "(ln:" + std::to_string(record.line) + ")]: " + record.message
+				+ "\n\t[file: " + record.file + "]\n";
+			//#if _DEBUG
+			l.consoleText += std::string("[") + name + "]: " + record.message + "\n";
+			//#endif
+		}
+		l.batch.clear();
+
+		// one write and one flush per batch
+		l.file.write(l.fileText.data(), l.fileText.size());
+		l.file.flush();
+		std::cout.write(l.consoleText.data(), l.consoleText.size());
+		std::cout.flush();
+		l.fileText.clear();
+		l.consoleText.clear();
+	}
 
-	// add msg
-	filestream << "[Log(ln:" << line << ")]: " << msg << std::endl << "\t[file: " << file << "]" << std::endl;
-	//#if _DEBUG
-	std::cout << "[Log]: " << msg << std::endl;
-	//#endif
+	void writer_main(logger* l) {
+		if (l->path == "") l->path = find_log_path();
+		l->file.open(l->path, std::ios::app);
+
+		std::vector<record_queue*> queues;
+		std::unique_lock<std::mutex> lock(l->lock);
+		while (true) {
+			l->wake.wait_for(lock, std::chrono::milliseconds(10), [l] {
+				return l->quit || l->urgent.load(std::memory_order_relaxed) || l->flushRequested != l->flushCompleted;
+			});
+			l->urgent.store(false, std::memory_order_relaxed);
+			const alc::uint64 request = l->flushRequested;
+			const bool quit = l->quit;
+			queues.clear();
+			for (auto& queue : l->queues) queues.push_back(queue.get());
+
+			// format and write without blocking threads that are registering
+			lock.unlock();
+			write_records(*l, queues);
+			lock.lock();
+
+			l->flushCompleted = request;
+			l->flushed.notify_all();
+			if (quit) break;
+		}
 
-	// close
-	filestream.close();
-}
+		l->file.close();
+	}
 
-void alc::debugger::trace(const std::string& msg, const std::string& file, size_t line) {
-	mutex_guard mg(s_lock);
-	// open file at the end
-	std::ofstream filestream;
-	filestream.open(get_log_path(), std::ios::app);
+	// registers the calling thread and starts the writer thread if needed
+	record_queue* get_queue(logger& l) {
+		if (t_queue && l.running.load(std::memory_order_acquire)) return t_queue;
 
-	// add msg
-	filestream << "[Trace(ln:" << line << ")]: " << msg << std::endl << "\t[file: " << file << "]" << std::endl;
-	//#if _DEBUG
-	std::cout << "[Trace]: " << msg << std::endl;
-	//#endif
+		std::lock_guard<std::mutex> _(l.lock);
+		if (t_queue == nullptr) {
+			l.queues.push_back(std::make_unique<record_queue>());
+			t_queue = l.queues.back().get();
+			t_threadIndex = static_cast<alc::uint32>(l.queues.size() - 1);
+		}
+		if (!l.running.load(std::memory_order_relaxed)) {
+			l.quit = false;
+			l.writer = std::thread(writer_main, &l);
+			l.running.store(true, std::memory_order_release);
+		}
+		return t_queue;
+	}
 
-	// close
-	filestream.close();
+	// writes every remaining record and joins the writer thread
+	void stop(logger& l) {
+		{
+			std::lock_guard<std::mutex> _(l.lock);
+			if (!l.running.load(std::memory_order_relaxed)) return;
+			l.quit = true;
+		}
+		l.wake.notify_one();
+		l.writer.join();
+		l.running.store(false, std::memory_order_release);
+	}
+
+	logger::~logger() {
+		stop(*this);
+	}
+
+}
+
+void alc::debugger::log(std::string msg, const char* file, size_t line) {
+	write(log_level::log, std::move(msg), file, line);
+}
+
+void alc::debugger::trace(std::string msg, const char* file, size_t line) {
+	write(log_level::trace, std::move(msg), file, line);
 }
 
-void alc::debugger::warning(const std::string& msg, const std::string& file, size_t line) {
-	mutex_guard mg(s_lock);
-	// open file at the end
-	std::ofstream filestream;
-	filestream.open(get_log_path(), std::ios::app);
+void alc::debugger::warning(std::string msg, const char* file, size_t line) {
+	write(log_level::warning, std::move(msg), file, line);
+}
 
-	// add msg
-	filestream << "[Warning(ln:" << line << ")]: " << msg << std::endl << "\t[file: " << file << "]" << std::endl;
-	//#if _DEBUG
-	std::cout << "[Warning]: " << msg << std::endl;
-	//#endif
+void alc::debugger::error(std::string msg, const char* file, size_t line) {
+	write(log_level::error, std::move(msg), file, line);
+}
 
-	// close
-	filestream.close();
+void alc::debugger::fatal_error(std::string msg, const char* file, size_t line) {
+	write(log_level::fatal_error, std::move(msg), file, line);
+	flush();
 }
 
-void alc::debugger::error(const std::string& msg, const std::string& file, size_t line) {
-	mutex_guard mg(s_lock);
-	// open file at the end
-	std::ofstream filestream;
-	filestream.open(get_log_path(), std::ios::app);
+void alc::debugger::write(log_level level, std::string msg, const char* file, size_t line) {
+	if (!is_enabled(level)) return;
+	logger& l = get_logger();
+	record_queue* queue = get_queue(l);
 
-	// add msg
-	filestream << "[Error(ln:" << line << ")]: " << msg << std::endl << "\t[file: " << file << "]" << std::endl;
-	//#if _DEBUG
-	std::cout << "[Error]: " << msg << std::endl;
-	//#endif
+	const int64 time = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - l.start).count();
+	queue->emplace(log_record{ time, file, static_cast<uint32>(line), t_threadIndex, level, std::move(msg) });
+
+	// dont wait for the next batch to report errors
+	if (level >= log_level::error) {
+		{
+			// set under the lock so the writer cant miss it between checking and waiting
+			std::lock_guard<std::mutex> _(l.lock);
+			l.urgent.store(true, std::memory_order_relaxed);
+		}
+		l.wake.notify_one();
+	}
+}
 
-	// close
-	filestream.close();
+alc::log_level alc::debugger::get_min_level() {
+	return s_minLevel.load(std::memory_order_relaxed);
 }
 
-void alc::debugger::fatal_error(const std::string& msg, const std::string& file, size_t line) {
-	mutex_guard mg(s_lock);
-	// open file at the end
-	std::ofstream filestream;
-	filestream.open(get_log_path(), std::ios::app);
+void alc::debugger::set_min_level(log_level level) {
+	s_minLevel.store(level, std::memory_order_relaxed);
+}
 
-	// add msg
-	filestream << "[FatalError(ln:" << line << ")]: " << msg << std::endl << "\t[file: " << file << "]" << std::endl;
-	//#if _DEBUG
-	std::cout << "[FatalError]: " << msg << std::endl;
-	//#endif
+void alc::debugger::flush() {
+	logger& l = get_logger();
+	if (!l.running.load(std::memory_order_acquire)) return;
 
-	// close
-	filestream.close();
+	std::unique_lock<std::mutex> lock(l.lock);
+	const uint64 request = ++l.flushRequested;
+	l.wake.notify_one();
+	l.flushed.wait(lock, [&l, request] { return l.flushCompleted >= request; });
 }
+
+void alc::debugger::shutdown() {
+	stop(get_logger());
+}
\ No newline at end of file
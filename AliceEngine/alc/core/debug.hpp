@@ -3,26 +3,68 @@
 #include <glm\glm.hpp>
 #include <glm\gtx\string_cast.hpp>
 #include <string>
-#include <mutex>
+#include <atomic>
 #include "../common.hpp"
 
+// the lowest level that is compiled in, calls below it are removed entirely
+// define it in the project settings to strip logging from release builds
+#ifndef ALC_LOG_MIN_LEVEL
+#define ALC_LOG_MIN_LEVEL 0
+#endif
+
+#define ALC_LOG_LEVEL_TRACE 0
+#define ALC_LOG_LEVEL_LOG 1
+#define ALC_LOG_LEVEL_WARNING 2
+#define ALC_LOG_LEVEL_ERROR 3
+#define ALC_LOG_LEVEL_FATAL_ERROR 4
+
 namespace alc {
 
+	enum class log_level : uint8 {
+		trace = ALC_LOG_LEVEL_TRACE,
+		log = ALC_LOG_LEVEL_LOG,
+		warning = ALC_LOG_LEVEL_WARNING,
+		error = ALC_LOG_LEVEL_ERROR,
+		fatal_error = ALC_LOG_LEVEL_FATAL_ERROR
+	};
+
+	// asynchronous logger
+	// each thread writes its records into its own queue without locking,
+	// a background thread formats them in the order they were written and writes them to the log file and console
 	class debugger {
 		ALC_STATIC_CLASS(debugger);
 	public:
 
-		static void log(const std::string& msg, const std::string& file, size_t line);
-		static void trace(const std::string& msg, const std::string& file, size_t line);
-		static void warning(const std::string& msg, const std::string& file, size_t line);
-		static void error(const std::string& msg, const std::string& file, size_t line);
-		static void fatal_error(const std::string& msg, const std::string& file, size_t line);
+		static void log(std::string msg, const char* file, size_t line);
+		static void trace(std::string msg, const char* file, size_t line);
+		static void warning(std::string msg, const char* file, size_t line);
+		static void error(std::string msg, const char* file, size_t line);
 
-	private:
+		// waits for the message to be written
+		static void fatal_error(std::string msg, const char* file, size_t line);
+
+		// queues a record to be written
+		// file must be a string literal since only the pointer is stored
+		static void write(log_level level, std::string msg, const char* file, size_t line);
+
+		// returns true if records of this level are written
+		static bool is_enabled(log_level level);
+
+		// the lowest level that is written, lower levels are skipped before the message is built
+		static log_level get_min_level();
+
+		// the lowest level that is written, lower levels are skipped before the message is built
+		static void set_min_level(log_level level);
+
+		// blocks until every record queued before this call has been written
+		static void flush();
+
+		// writes every remaining record and stops the background thread
+		// logging again starts it back up
+		static void shutdown();
 
-		static inline std::mutex s_lock;
-		static inline std::string s_logFilepath = "";
-		static const std::string& get_log_path();
+	private:
+		static inline std::atomic<log_level> s_minLevel = log_level::trace;
 	};
 
 	namespace detail {
@@ -30,16 +72,47 @@ namespace alc {
 		using glm::to_string;
 	}
 
+
+	// implementations
+
+	inline bool debugger::is_enabled(log_level level) {
+		return level >= s_minLevel.load(std::memory_order_relaxed);
+	}
+
 }
 
+#define ALC_DEBUG_WRITE(level, msg) \
+	do { if (::alc::debugger::is_enabled(level)) ::alc::debugger::write(level, msg, __FILE__, __LINE__); } while (0)
+
+#if ALC_LOG_MIN_LEVEL <= ALC_LOG_LEVEL_LOG
 #define ALC_DEBUG_LOG(msg) \
-	::alc::debugger::log(msg, __FILE__, __LINE__)
+	ALC_DEBUG_WRITE(::alc::log_level::log, msg)
+#else
+#define ALC_DEBUG_LOG(msg) ((void)0)
+#endif
+
+#if ALC_LOG_MIN_LEVEL <= ALC_LOG_LEVEL_TRACE
 #define ALC_DEBUG_TRACE(msg) \
-	::alc::debugger::trace(msg, __FILE__, __LINE__)
+	ALC_DEBUG_WRITE(::alc::log_level::trace, msg)
+#else
+#define ALC_DEBUG_TRACE(msg) ((void)0)
+#endif
+
+#if ALC_LOG_MIN_LEVEL <= ALC_LOG_LEVEL_WARNING
 #define ALC_DEBUG_WARNING(msg) \
-	::alc::debugger::warning(msg, __FILE__, __LINE__)
+	ALC_DEBUG_WRITE(::alc::log_level::warning, msg)
+#else
+#define ALC_DEBUG_WARNING(msg) ((void)0)
+#endif
+
+#if ALC_LOG_MIN_LEVEL <= ALC_LOG_LEVEL_ERROR
 #define ALC_DEBUG_ERROR(msg) \
-	::alc::debugger::error(msg, __FILE__, __LINE__)
+	ALC_DEBUG_WRITE(::alc::log_level::error, msg)
+#else
+#define ALC_DEBUG_ERROR(msg) ((void)0)
+#endif
+
+// fatal errors are never stripped
 #define ALC_DEBUG_FATAL_ERROR(msg) \
 	::alc::debugger::fatal_error(msg, __FILE__, __LINE__)
 
@@ -1,6 +1,19 @@
 #include "engine.hpp"
 #include "alice_events.hpp"
+#include "profiler.hpp"
+#include "timers.hpp"
+#include "../jobs/job_system.hpp"
 #include <chrono>
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
 
 namespace alc {
 
@@ -8,6 +21,52 @@ namespace alc {
 	using duration = std::chrono::duration<double>;
 	using time_point = std::chrono::time_point<clock, duration>;
 
+	namespace {
+
+		// sleeps until close to the target and then spins for the rest
+		// keeps track of how long sleeping actually takes so it only spins as long as it needs to
+		class frame_limiter final {
+		public:
+			frame_limiter() {
+				#ifdef _WIN32
+				// the default scheduler period is about 15ms which makes every sleep overshoot
+				timeBeginPeriod(1);
+				#endif
+			}
+
+			~frame_limiter() {
+				#ifdef _WIN32
+				timeEndPeriod(1);
+				#endif
+			}
+
+			void wait_until(time_point target) {
+				while (duration(target - clock::now()).count() > m_estimate) {
+					const time_point start = clock::now();
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					add_sample(duration(clock::now() - start).count());
+				}
+				while (clock::now() < target) std::this_thread::yield();
+			}
+
+		private:
+			// mean plus one standard deviation of the sleep time
+			// the mean and variance are weighted towards recent samples so they stay bounded and follow changes
+			static constexpr double weight = 0.02;
+			double m_estimate = 0.005;
+			double m_mean = 0.005;
+			double m_variance = 0.0;
+
+			void add_sample(double observed) {
+				const double delta = observed - m_mean;
+				m_mean += weight * delta;
+				m_variance = (1.0 - weight) * (m_variance + weight * delta * delta);
+				m_estimate = m_mean + std::sqrt(m_variance);
+			}
+		};
+
+	}
+
 	void engine::start(const engine_settings* set) {
 		// check if already running and refuse if so
 		if (s_isRunning) {
@@ -15,9 +74,16 @@ namespace alc {
 			return;
 		}
 		s_isRunning = true;
+		s_engineSettings = set;
+
+		// set before the game is created so it can change it in init
+		set_target_framerate(set->general.targetFramerate);
 
 		// initialize /////////////////////////////////////////////////
 
+		// start the job system, this thread becomes worker 0
+		if (set->jobs.enabled) job_system::start(set->jobs.threadCount);
+
 		// create timer
 		time_point lasttime, thistime;
 		lasttime = thistime = clock::now();
@@ -40,25 +106,78 @@ namespace alc {
 
 		// game loop //////////////////////////////////////////////////
 
+		// fixed timestep
+		const uint32 tickRate = set->general.fixedTickRate;
+		const double tickLength = tickRate > 0 ? 1.0 / static_cast<double>(tickRate) : 0.0;
+		uint32 maxTicks = set->general.maxTicksPerFrame;
+		if (tickLength > 0.0 && maxTicks == 0) {
+			ALC_DEBUG_WARNING("general.maxTicksPerFrame is 0, running 1 tick per frame instead");
+			maxTicks = 1;
+		}
+		double accumulator = 0.0;
+		s_tick = 0;
+
+		// frame limiting
+		frame_limiter limiter;
+		time_point frameTarget = clock::now();
+
+		// dont count the time spent initializing
+		thistime = clock::now();
+
 		while (s_isRunning && !s_shouldQuit) {
 			// get begining of frame and timestep
 			lasttime = thistime;
 			thistime = clock::now();
-			timestep ts(duration(thistime - lasttime).count());
+			const double delta = duration(thistime - lasttime).count();
 
-			// update
-			if (s_game) s_game->update(ts);
-			if (scenes_enabled) scene_manager::__update(ts);
-			alice_events::onUpdate(ts);
+			{
+				ALC_PROFILE_SCOPE("frame");
 
-			// TODO: render
-			s_game->draw();
-			if (scenes_enabled) scene_manager::__draw();
+				// update
+				if (tickLength > 0.0) {
+					// run as many fixed ticks as the time passed allows
+					accumulator += delta;
+					uint32 ticks = 0;
+					while (accumulator >= tickLength) {
+						// too far behind, drop the time instead of trying to catch up
+						if (ticks == maxTicks) {
+							accumulator = std::fmod(accumulator, tickLength);
+							break;
+						}
+						update(timestep(tickLength), scenes_enabled);
+						accumulator -= tickLength;
+						++ticks;
+					}
+					s_interpolationAlpha = accumulator / tickLength;
+				} else {
+					update(timestep(delta), scenes_enabled);
+					s_interpolationAlpha = 1.0;
+				}
+
+				// TODO: render
+				if (s_game) {
+					ALC_PROFILE_SCOPE("game::draw");
+					s_game->draw();
+				}
+				if (scenes_enabled) {
+					ALC_PROFILE_SCOPE("scene_manager::__draw");
+					scene_manager::__draw();
+				}
+			}
+
+			// move this frame's profiling scopes out of the thread buffers
+			profiler::__collect();
 
 			// wait for end of frame
-			if (s_targetFramerate != 0) {
-				double length = duration(clock::now() - thistime).count();
-				while (length < s_frameLength) std::this_thread::yield();
+			if (s_frameLength > 0.0) {
+				ALC_PROFILE_SCOPE("engine::wait");
+				// targets are spaced evenly so the framerate doesnt drift, unless we fell behind
+				frameTarget += duration(s_frameLength);
+				const time_point now = clock::now();
+				if (frameTarget < now) frameTarget = now;
+				limiter.wait_until(frameTarget);
+			} else {
+				frameTarget = clock::now();
 			}
 		}
 
@@ -67,6 +186,9 @@ namespace alc {
 		// delete scenes 
 		if (scenes_enabled) scene_manager::__exit();
 
+		// drop timers that never fired, they might point into the scenes or the game
+		timers::__clear();
+
 		// delete game
 		if (s_game) {
 			s_game->exit();
@@ -76,10 +198,39 @@ namespace alc {
 		// close window
 		delete s_window; s_window = nullptr;
 
+		// stop the job system
+		if (set->jobs.enabled) job_system::stop();
+
+		// write out anything still being logged
+		debugger::flush();
+
 	}
 
 	void engine::quit() { s_shouldQuit = true; }
 
+	void engine::update(timestep ts, bool scenesEnabled) {
+		timers::__update(ts);
+		if (s_game) {
+			ALC_PROFILE_SCOPE("game::update");
+			s_game->update(ts);
+		}
+		if (scenesEnabled) {
+			ALC_PROFILE_SCOPE("scene_manager::__update");
+			scene_manager::__update(ts);
+		}
+		{
+			ALC_PROFILE_SCOPE("alice_events::onUpdate");
+			alice_events::onUpdate(ts);
+		}
+
+		// sync point, dispatch events posted from other threads
+		{
+			ALC_PROFILE_SCOPE("alice_events::__flush");
+			alice_events::__flush();
+		}
+		++s_tick;
+	}
+
 	const engine_settings* engine::get_engine_settings() {
 		return s_engineSettings;
 	}
@@ -96,6 +247,18 @@ namespace alc {
 		return s_targetFramerate;
 	}
 
+	bool engine::is_fixed_timestep() {
+		return s_engineSettings && s_engineSettings->general.fixedTickRate > 0;
+	}
+
+	double engine::get_interpolation_alpha() {
+		return s_interpolationAlpha;
+	}
+
+	uint64 engine::get_tick() {
+		return s_tick;
+	}
+
 	void engine::set_target_framerate(uint32 framerate) {
 		s_targetFramerate = framerate;
 		if (s_targetFramerate == 0)
@@ -13,6 +13,8 @@ namespace alc {
 		// basic initialization
 		struct {
 			uint32 targetFramerate = 0; // if 0 then the framerate becomes uncapped
+			uint32 fixedTickRate = 0; // updates per second, if 0 then updates run once per frame with a variable timestep
+			uint32 maxTicksPerFrame = 5; // fixed updates run in one frame before the remaining time is dropped, at least 1
 		} general;
 
 		// window initialization
@@ -36,6 +38,7 @@ namespace alc {
 		// setup jobsystem -- optional
 		struct {
 			bool enabled = false; // must be enabled to use jobsystem
+			uint32 threadCount = 0; // number of worker threads, if 0 then it uses one less than the hardware thread count
 		} jobs;
 
 	};
@@ -68,6 +71,17 @@ namespace alc {
 		// uncapped if set to 0
 		static void set_target_framerate(uint32 framerate);
 
+		// returns true if updates run at general.fixedTickRate
+		static bool is_fixed_timestep();
+
+		// how far between the last fixed update and the next one this frame is, from 0 to 1
+		// use it to interpolate between the previous and current state when drawing
+		// always 1 when not using a fixed timestep
+		static double get_interpolation_alpha();
+
+		// the number of updates since the engine started
+		static uint64 get_tick();
+
 	private:
 		static inline const engine_settings* s_engineSettings = nullptr;
 		static inline bool s_isRunning = false;
@@ -76,6 +90,10 @@ namespace alc {
 		static inline double s_frameLength = 0.0;
 		static inline window* s_window = nullptr;
 		static inline game* s_game = nullptr;
+		static inline double s_interpolationAlpha = 1.0;
+		static inline uint64 s_tick = 0;
+
+		static void update(timestep ts, bool scenesEnabled);
 	};
 
 }
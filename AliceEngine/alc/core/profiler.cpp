@@ -0,0 +1,185 @@
+#include "profiler.hpp"
+#include "../datatypes/spsc_queue.hpp"
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace alc {
+
+	namespace {
+
+		using clock = std::chrono::steady_clock;
+
+		struct scope_record final {
+			const char* name;
+			int64 begin;
+			int64 end;
+			uint32 depth;
+		};
+
+		struct captured_scope final {
+			uint32 name;
+			uint32 thread;
+			uint32 depth;
+			int64 begin;
+			int64 end;
+		};
+
+		using record_queue = spsc_queue<scope_record, 512>;
+
+		const clock::time_point s_start = clock::now();
+
+		// every thread that ever recorded, never removed so the thread's pointer stays valid
+		std::mutex s_lock;
+		std::vector<std::unique_ptr<record_queue>> s_queues;
+
+		// the capture, names are copied when collected so they dont need to outlive it
+		std::vector<captured_scope> s_scopes;
+		std::vector<std::string> s_names;
+		std::unordered_map<std::string, uint32> s_nameLookup;
+		// names only live until the next collect so an address can be reused for another name,
+		// this is cleared every collect and only saves looking up the same string again
+		std::unordered_map<const char*, uint32> s_pointerLookup;
+
+		// names interned for scopes, nodes dont move so the strings stay where they are
+		std::mutex s_internLock;
+		std::unordered_set<std::string> s_interned;
+
+		thread_local record_queue* t_queue = nullptr;
+		thread_local uint32 t_depth = 0;
+
+		record_queue* get_queue() {
+			if (t_queue) return t_queue;
+			std::lock_guard<std::mutex> _(s_lock);
+			s_queues.push_back(std::make_unique<record_queue>());
+			return t_queue = s_queues.back().get();
+		}
+
+		// must hold s_lock
+		uint32 name_index(const char* name) {
+			auto it = s_pointerLookup.find(name);
+			if (it != s_pointerLookup.end()) return it->second;
+
+			auto [named, added] = s_nameLookup.try_emplace(name, static_cast<uint32>(s_names.size()));
+			if (added) s_names.emplace_back(name);
+			s_pointerLookup.emplace(name, named->second);
+			return named->second;
+		}
+
+		std::string escape_json(const std::string& str) {
+			std::string result;
+			result.reserve(str.size());
+			for (char c : str) {
+				if (c == '"' || c == '\\') result += '\\';
+				if (static_cast<unsigned char>(c) < 0x20) continue;
+				result += c;
+			}
+			return result;
+		}
+
+	}
+
+	profile_name profiler::intern(std::string_view name) {
+		std::lock_guard<std::mutex> _(s_internLock);
+		return profile_name{ s_interned.emplace(name).first->c_str() };
+	}
+
+	void profiler::begin_capture() {
+		// throw away anything recorded before
+		__collect();
+		std::lock_guard<std::mutex> _(s_lock);
+		s_scopes.clear();
+		s_names.clear();
+		s_nameLookup.clear();
+		s_isCapturing = true;
+	}
+
+	void profiler::end_capture() {
+		__collect();
+		s_isCapturing = false;
+	}
+
+	size_t profiler::get_scope_count() {
+		std::lock_guard<std::mutex> _(s_lock);
+		return s_scopes.size();
+	}
+
+	bool profiler::save_chrome_trace(const std::string& path) {
+		std::lock_guard<std::mutex> _(s_lock);
+		std::ofstream file(path);
+		if (!file.is_open()) return false;
+
+		// complete events, times are in microseconds
+		std::string text = "{\"traceEvents\":[\n";
+		for (size_t i = 0; i < s_scopes.size(); i++) {
+			const captured_scope& scope = s_scopes[i];
+			text += "{\"name\":\"" + escape_json(s_names[scope.name]) + "\",\"ph\":\"X\",\"pid\":0"
+				+ ",\"tid\":" + std::to_string(scope.thread)
+				+ ",\"ts\":" + std::to_string(static_cast<double>(scope.begin) / 1000.0)
+				+ ",\"dur\":" + std::to_string(static_cast<double>(scope.end - scope.begin) / 1000.0)
+				+ ",\"args\":{\"depth\":" + std::to_string(scope.depth) + "}}";
+			text += i + 1 < s_scopes.size() ? ",\n" : "\n";
+		}
+		text += "],\"displayTimeUnit\":\"ms\"}\n";
+
+		file.write(text.data(), text.size());
+		return file.good();
+	}
+
+	bool profiler::save_capture(const std::string& path) {
+		std::lock_guard<std::mutex> _(s_lock);
+		std::ofstream file(path, std::ios::binary);
+		if (!file.is_open()) return false;
+
+		auto write = [&file](const auto& value) {
+			file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		};
+
+		file.write("ALCP", 4);
+		write(uint32(1));
+		write(static_cast<uint32>(s_names.size()));
+		for (auto& name : s_names) {
+			write(static_cast<uint32>(name.size()));
+			file.write(name.data(), name.size());
+		}
+		write(static_cast<uint64>(s_scopes.size()));
+		for (auto& scope : s_scopes) {
+			write(scope.name);
+			write(scope.thread);
+			write(scope.depth);
+			write(scope.begin);
+			write(scope.end);
+		}
+		return file.good();
+	}
+
+	void profiler::__collect() {
+		std::lock_guard<std::mutex> _(s_lock);
+		// scopes that finish after the capture ended are thrown away
+		const bool keep = is_capturing();
+		s_pointerLookup.clear();
+		for (size_t i = 0; i < s_queues.size(); i++) {
+			const uint32 thread = static_cast<uint32>(i);
+			s_queues[i]->consume([thread, keep](scope_record&& record) {
+				if (keep) s_scopes.push_back(captured_scope{ name_index(record.name), thread, record.depth, record.begin, record.end });
+			});
+		}
+	}
+
+	int64 profiler::__now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - s_start).count();
+	}
+
+	uint32 profiler::__push() {
+		return t_depth++;
+	}
+
+	void profiler::__record(const char* name, int64 begin, uint32 depth) {
+		const int64 end = __now();
+		t_depth = depth;
+		get_queue()->emplace(scope_record{ name, begin, end, depth });
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#ifndef ALC_CORE_PROFILER_HPP
+#define ALC_CORE_PROFILER_HPP
+#include "../common.hpp"
+#include <atomic>
+#include <string_view>
+
+namespace alc {
+
+	// a scope name built at runtime, returned by profiler::intern
+	struct profile_name final {
+		const char* str = "";
+	};
+
+	// static cpu profiler
+	// scopes are recorded into a buffer per thread without locking while a capture is running,
+	// the engine collects them once per frame
+	// a capture can be saved as chrome trace json (open in chrome://tracing or perfetto) or as a compact binary file
+	class profiler final {
+		ALC_STATIC_CLASS(profiler);
+	public:
+
+		// clears the previous capture and starts recording
+		static void begin_capture();
+
+		// stops recording
+		static void end_capture();
+
+		// returns true while recording
+		static bool is_capturing();
+
+		// copies a name built at runtime so it can be used for scopes, the copy lives until the program exits
+		// the same name always returns the same copy, intern names once and keep them instead of every scope
+		// can be called from any thread
+		static profile_name intern(std::string_view name);
+
+		// returns the number of recorded scopes
+		static size_t get_scope_count();
+
+		// saves the capture as chrome trace_event json
+		// returns false if the file could not be written
+		static bool save_chrome_trace(const std::string& path);
+
+		// saves the capture in the binary format:
+		// "ALCP", uint32 version, uint32 nameCount, names as (uint32 length, chars),
+		// uint64 scopeCount, scopes as (uint32 name, uint32 thread, uint32 depth, int64 begin, int64 end) in nanoseconds
+		// returns false if the file could not be written
+		static bool save_capture(const std::string& path);
+
+		// moves the scopes recorded by every thread into the capture
+		static void __collect();
+
+		// returns the time in nanoseconds since the profiler started
+		static int64 __now();
+
+		// marks the start of a scope on this thread and returns its depth
+		static uint32 __push();
+
+		// records a finished scope on this thread
+		static void __record(const char* name, int64 begin, uint32 depth);
+
+	private:
+		static inline std::atomic_bool s_isCapturing = false;
+	};
+
+	// records the time between its construction and destruction
+	// names are kept until the end of the frame, so only string literals and names from profiler::intern are taken
+	class profile_scope final {
+		ALC_NO_COPY(profile_scope);
+		ALC_NO_MOVE(profile_scope);
+	public:
+		template<size_t N> profile_scope(const char (&name)[N]);
+		profile_scope(profile_name name);
+		~profile_scope();
+	private:
+		const char* m_name;
+		int64 m_begin;
+		uint32 m_depth;
+	};
+
+
+	// implementations
+
+	inline bool profiler::is_capturing() {
+		return s_isCapturing.load(std::memory_order_relaxed);
+	}
+
+	template<size_t N>
+	inline profile_scope::profile_scope(const char (&name)[N]) : profile_scope(profile_name{ name }) { }
+
+	inline profile_scope::profile_scope(profile_name name) : m_name(nullptr), m_begin(0), m_depth(0) {
+		if (profiler::is_capturing()) {
+			m_name = name.str;
+			m_depth = profiler::__push();
+			m_begin = profiler::__now();
+		}
+	}
+
+	inline profile_scope::~profile_scope() {
+		if (m_name) profiler::__record(m_name, m_begin, m_depth);
+	}
+
+}
+
+#define ALC_PROFILE_CONCAT_IMPL(a, b) a##b
+#define ALC_PROFILE_CONCAT(a, b) ALC_PROFILE_CONCAT_IMPL(a, b)
+
+// profiles the rest of the current scope
+// define ALC_NO_PROFILE to remove every scope
+#ifndef ALC_NO_PROFILE
+#define ALC_PROFILE_SCOPE(name) \
+	::alc::profile_scope ALC_PROFILE_CONCAT(_alcProfileScope, __COUNTER__)(name)
+#else
+#define ALC_PROFILE_SCOPE(name) ((void)0)
+#endif
+
+#endif // !ALC_CORE_PROFILER_HPP
\ No newline at end of file
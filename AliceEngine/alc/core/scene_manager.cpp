@@ -1,10 +1,32 @@
 #include "scene_manager.hpp"
 #include "debug.hpp"
 #include "engine.hpp"
+#include "profiler.hpp"
+#include "alice_events.hpp"
+#include "../entities/entity_factory.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 namespace alc {
 
-	scene::~scene() { }
+	namespace {
+
+		// loads are done one at a time in the order they were requested
+		std::mutex s_loadLock;
+		std::condition_variable s_loadSignal;
+		std::deque<std::shared_ptr<scene_load>> s_loadQueue;
+		std::thread s_loader;
+		bool s_stopLoading = false;
+
+	}
+
+	scene::~scene() {
+		// timers given to the scene would call into it after it is gone
+		timers::cancel_owned(this);
+	}
 
 	size_t scene::get_index() const {
 		return m_index;
@@ -14,6 +36,22 @@ namespace alc {
 		return m_name;
 	}
 
+	memory_arena* scene::get_arena() {
+		return m_arena.get();
+	}
+
+	void scene::set_load_progress(float progress) {
+		if (m_load) m_load->m_progress.store(std::clamp(progress, 0.0f, 1.0f), std::memory_order_relaxed);
+	}
+
+	timer_handle scene::after(double seconds, const function<void>& fn) {
+		return timers::after(seconds, fn, this);
+	}
+
+	timer_handle scene::after_updates(uint64 count, const function<void>& fn) {
+		return timers::after_updates(count, fn, this);
+	}
+
 	void scene::__set_index(size_t index) {
 		m_index = index;
 	}
@@ -22,6 +60,56 @@ namespace alc {
 		m_name = name;
 	}
 
+	void scene::__set_load(scene_load* load) {
+		m_load = load;
+	}
+
+	std::vector<entity_factory*>* scene::__get_factories() {
+		return &m_factories;
+	}
+
+	void scene::__set_arena(std::unique_ptr<memory_arena>&& arena) {
+		m_arena = std::move(arena);
+	}
+
+	// scene_load
+
+	scene_load::scene_load(const scene_binding* binding, bool additive, bool preload)
+		: m_binding(binding), m_additive(additive), m_preload(preload), m_pooled(false), m_index(static_cast<size_t>(-1)), m_progress(0.0f), m_loaded(false), m_done(false), m_active(nullptr) { }
+
+	scene_load::~scene_load() { }
+
+	float scene_load::get_progress() const {
+		if (m_loaded.load(std::memory_order_acquire)) return 1.0f;
+		return m_progress.load(std::memory_order_relaxed);
+	}
+
+	bool scene_load::is_loaded() const {
+		return m_loaded.load(std::memory_order_acquire);
+	}
+
+	bool scene_load::is_done() const {
+		return m_done.load(std::memory_order_acquire);
+	}
+
+	scene* scene_load::get_scene() const {
+		return is_done() ? m_active : nullptr;
+	}
+
+	const scene_binding* scene_load::get_binding() const {
+		return m_binding;
+	}
+
+	bool scene_load::is_additive() const {
+		return m_additive;
+	}
+
+	bool scene_load::is_preload() const {
+		return m_preload;
+	}
+
+	// scene_manager
+
 	bool scene_manager::load_scene(size_t sceneBindingIndex) {
 		if (!s_eSettings) {
 			ALC_DEBUG_WARNING("scene_manager is disabled");
@@ -86,6 +174,62 @@ namespace alc {
 		return false;
 	}
 
+	std::shared_ptr<scene_load> scene_manager::load_scene_async(size_t sceneBindingIndex) {
+		return load_async(find_binding(sceneBindingIndex), false, false);
+	}
+
+	std::shared_ptr<scene_load> scene_manager::load_scene_async(const std::string& sceneName) {
+		return load_async(find_binding(sceneName), false, false);
+	}
+
+	std::shared_ptr<scene_load> scene_manager::load_scene_additive_async(size_t sceneBindingIndex) {
+		return load_async(find_binding(sceneBindingIndex), true, false);
+	}
+
+	std::shared_ptr<scene_load> scene_manager::load_scene_additive_async(const std::string& sceneName) {
+		return load_async(find_binding(sceneName), true, false);
+	}
+
+	size_t scene_manager::loading_scenes_size() {
+		return s_asyncLoads.size();
+	}
+
+	bool scene_manager::preload_scene(size_t sceneBindingIndex) {
+		return preload(find_binding(sceneBindingIndex));
+	}
+
+	bool scene_manager::preload_scene(const std::string& sceneName) {
+		return preload(find_binding(sceneName));
+	}
+
+	std::shared_ptr<scene_load> scene_manager::preload_scene_async(size_t sceneBindingIndex) {
+		return load_async(find_binding(sceneBindingIndex), false, true);
+	}
+
+	std::shared_ptr<scene_load> scene_manager::preload_scene_async(const std::string& sceneName) {
+		return load_async(find_binding(sceneName), false, true);
+	}
+
+	size_t scene_manager::pooled_scenes_size() {
+		return s_pooledScenes.size();
+	}
+
+	bool scene_manager::is_scene_pooled(const std::string& sceneName) {
+		for (auto& pooled : s_pooledScenes) {
+			if (pooled.binding->name == sceneName) return true;
+		}
+		return false;
+	}
+
+	void scene_manager::clear_scene_pool() {
+		for (auto& pooled : s_pooledScenes) {
+			pooled.scene->exit();
+			pooled.scene.reset();
+			ALC_DEBUG_LOG("Closed scene " + pooled.binding->name);
+		}
+		s_pooledScenes.clear();
+	}
+
 	bool scene_manager::unload_scene(size_t activeSceneIndex) {
 		if (!s_eSettings) {
 			ALC_DEBUG_WARNING("scene_manager is disabled");
@@ -93,7 +237,7 @@ namespace alc {
 		}
 
 		// check for valid index
-		if (activeSceneIndex == 0 || activeSceneIndex > s_activeScenes.size()) {
+		if (activeSceneIndex == 0 || activeSceneIndex >= s_activeScenes.size()) {
 			ALC_DEBUG_WARNING("Could not unload scene because it was not a valid index or the primary scene was selected");
 			return false;
 		}
@@ -135,27 +279,12 @@ namespace alc {
 	void scene_manager::handle_scenes() {
 		// load primary scene
 		if (s_primarySceneToLoad) {
-			// destroy old scene
-			if (s_activeScenes.size() > 0) {
-				s_activeScenes[0].scene->exit();
-				s_activeScenes[0].scene.reset();
-				ALC_DEBUG_LOG("Closed scene " + s_activeScenes[0].binding->name);
-			}
-			// no scenes, create empty first spot
-			else {
-				s_activeScenes.emplace_back(nullptr, nullptr);
-			}
-			// create scene
-			scene* firstscene = s_primarySceneToLoad->create();
-			firstscene->__set_index(0);
-			firstscene->__set_name(s_primarySceneToLoad->name);
-			//s_activeScenes[0] = active_scene(firstscene, s_primarySceneToLoad);
-			s_activeScenes[0].scene.reset(firstscene);
-			s_activeScenes[0].binding = s_primarySceneToLoad;
-			s_activeScenes[0].shouldDestroy = false;
-			firstscene->init(s_primarySceneToLoad->args);
-			ALC_DEBUG_LOG("Created scene " + s_activeScenes[0].binding->name);
+			const scene_binding* binding = s_primarySceneToLoad;
 			s_primarySceneToLoad = nullptr;
+			// close the old scene first, a pooled binding can then be woken again
+			if (s_activeScenes.size() > 0) deactivate(s_activeScenes[0]);
+			scene* pooled = take_pooled(binding);
+			activate(pooled ? pooled : create_scene(binding, nullptr, 0), binding, false, pooled != nullptr);
 		}
 
 		// load / unload additive scenes
@@ -163,29 +292,279 @@ namespace alc {
 		// unload
 		if (s_checkForSceneChanges) {
 			s_checkForSceneChanges = false;
-			for (auto it = s_activeScenes.begin(); it != s_activeScenes.end(); ++it) {
+			for (auto it = s_activeScenes.begin(); it != s_activeScenes.end();) {
 				if (it->shouldDestroy) {
-					it->scene->exit();
-					it->scene.reset();
-					ALC_DEBUG_LOG("Closed scene " + it->binding->name);
+					deactivate(*it);
 					it = s_activeScenes.erase(it);
-				}
+				} else ++it;
+			}
+			// scenes after the unloaded ones moved down
+			for (size_t i = 0; i < s_activeScenes.size(); i++) {
+				s_activeScenes[i].scene->__set_index(i);
 			}
 		}
 
 		// load
 		if (s_scenesToLoad.size() > 0) {
 			for (size_t i = 0; i < s_scenesToLoad.size(); i++) {
-				scene* scene = s_scenesToLoad[i]->create();
-				scene->__set_index(s_activeScenes.size());
-				scene->__set_name(s_scenesToLoad[i]->name);
-				s_activeScenes.emplace_back(scene, s_scenesToLoad[i]);
-				scene->init(s_scenesToLoad[i]->args);
-				ALC_DEBUG_LOG("Created scene " + s_scenesToLoad[i]->name);
+				scene* pooled = take_pooled(s_scenesToLoad[i]);
+				activate(pooled ? pooled : create_scene(s_scenesToLoad[i], nullptr, s_activeScenes.size()), s_scenesToLoad[i], true, pooled != nullptr);
 			}
 			s_scenesToLoad.clear();
 		}
 
+		// swap in finished background loads, keeping the order they were requested in
+		size_t swapped = 0;
+		while (swapped < s_asyncLoads.size() && s_asyncLoads[swapped]->is_loaded()) {
+			swap_in(s_asyncLoads[swapped].get());
+			++swapped;
+		}
+		s_asyncLoads.erase(s_asyncLoads.begin(), s_asyncLoads.begin() + swapped);
+
+	}
+
+	const scene_binding* scene_manager::find_binding(size_t sceneBindingIndex) {
+		if (!s_eSettings) {
+			ALC_DEBUG_WARNING("scene_manager is disabled");
+			return nullptr;
+		}
+		if (sceneBindingIndex >= s_eSettings->scenemanager.sceneBindings.size()) return nullptr;
+		return &s_eSettings->scenemanager.sceneBindings[sceneBindingIndex];
+	}
+
+	const scene_binding* scene_manager::find_binding(const std::string& sceneName) {
+		if (!s_eSettings) {
+			ALC_DEBUG_WARNING("scene_manager is disabled");
+			return nullptr;
+		}
+		for (size_t i = 0; i < s_eSettings->scenemanager.sceneBindings.size(); i++) {
+			if (s_eSettings->scenemanager.sceneBindings[i].name == sceneName)
+				return &s_eSettings->scenemanager.sceneBindings[i];
+		}
+		return nullptr;
+	}
+
+	std::shared_ptr<scene_load> scene_manager::load_async(const scene_binding* binding, bool additive, bool preload) {
+		if (!binding) return nullptr;
+
+		if (preload) {
+			if (is_active_or_pooled(binding)) {
+				ALC_DEBUG_WARNING("Did not preload scene " + binding->name + " because it is already active or pooled");
+				return nullptr;
+			}
+			if (auto waiting = find_preload(binding)) return waiting;
+		}
+
+		auto load = std::make_shared<scene_load>(binding, additive, preload);
+
+		// the index the scene gets when swapped in, additive loads go after the ones still waiting
+		if (preload) load->m_index = static_cast<size_t>(-1);
+		else if (!additive) load->m_index = 0;
+		else {
+			load->m_index = s_activeScenes.size();
+			for (auto& waiting : s_asyncLoads) {
+				if (waiting->m_additive && !waiting->m_preload) ++load->m_index;
+			}
+		}
+		s_asyncLoads.push_back(load);
+
+		// a pooled scene is already loaded
+		scene* pooled = preload ? nullptr : take_pooled(binding);
+		if (pooled) {
+			load->m_scene.reset(pooled);
+			load->m_pooled = true;
+			load->m_loaded.store(true, std::memory_order_release);
+			return load;
+		}
+
+		{
+			std::lock_guard<std::mutex> _(s_loadLock);
+			s_loadQueue.push_back(load);
+			s_stopLoading = false;
+		}
+		s_loadSignal.notify_one();
+
+		// loads get their own thread instead of a job, the engine's thread runs jobs while it
+		// waits on them and would stall the frame if it picked up a load
+		if (!s_loader.joinable()) s_loader = std::thread(&scene_manager::loader_main);
+		return load;
+	}
+
+	scene* scene_manager::create_scene(const scene_binding* binding, scene_load* load, size_t index) {
+		// the arena has to exist before the scene so its members can use it
+		auto arena = std::make_unique<memory_arena>();
+		memory_arena* previous = memory_arena::get_current();
+		memory_arena::__set_current(arena.get());
+
+		// factories made by the constructor are moved to the scene once it exists
+		std::vector<entity_factory*> created;
+		entity_factory::__begin_staging(&created);
+		scene* s = binding->create();
+		entity_factory::__end_staging();
+		s->__set_arena(std::move(arena));
+
+		std::vector<entity_factory*>* factories = s->__get_factories();
+		for (entity_factory* factory : created) {
+			factory->__set_group(factories);
+			factories->push_back(factory);
+		}
+		s->__set_index(index);
+		s->__set_name(binding->name);
+		s->__set_load(load);
+
+		entity_factory::__begin_staging(factories);
+		s->load(binding->args);
+		entity_factory::__end_staging();
+		memory_arena::__set_current(previous);
+		return s;
+	}
+
+	void scene_manager::init_scene(scene* s, const scene_binding* binding) {
+		memory_arena* previous = memory_arena::get_current();
+		memory_arena::__set_current(s->get_arena());
+		entity_factory::__begin_staging(s->__get_factories());
+		s->init(binding->args);
+		entity_factory::__end_staging();
+		memory_arena::__set_current(previous);
+	}
+
+	bool scene_manager::preload(const scene_binding* binding) {
+		if (!binding) return false;
+		if (is_active_or_pooled(binding) || find_preload(binding)) {
+			ALC_DEBUG_WARNING("Did not preload scene " + binding->name + " because it is already active, pooled or being preloaded");
+			return false;
+		}
+		scene* s = create_scene(binding, nullptr, static_cast<size_t>(-1));
+		init_scene(s, binding);
+		park(s, binding);
+		ALC_DEBUG_LOG("Preloaded scene " + binding->name);
+		return true;
+	}
+
+	bool scene_manager::is_active_or_pooled(const scene_binding* binding) {
+		for (auto& active : s_activeScenes) {
+			if (active.scene && active.binding == binding) return true;
+		}
+		for (auto& pooled : s_pooledScenes) {
+			if (pooled.binding == binding) return true;
+		}
+		return false;
+	}
+
+	std::shared_ptr<scene_load> scene_manager::find_preload(const scene_binding* binding) {
+		for (auto& load : s_asyncLoads) {
+			if (load->m_preload && load->m_binding == binding) return load;
+		}
+		return nullptr;
+	}
+
+	scene* scene_manager::take_pooled(const scene_binding* binding) {
+		for (auto it = s_pooledScenes.begin(); it != s_pooledScenes.end(); ++it) {
+			if (it->binding == binding) {
+				scene* s = it->scene.release();
+				s_pooledScenes.erase(it);
+				return s;
+			}
+		}
+		return nullptr;
+	}
+
+	void scene_manager::park(scene* s, const scene_binding* binding) {
+		// pooled scenes are not updated and their timers wait until they are woken
+		for (entity_factory* factory : *s->__get_factories()) factory->__detach();
+		timers::pause_owned(s);
+		s->__set_index(static_cast<size_t>(-1));
+		s_pooledScenes.push_back(pooled_scene{ std::unique_ptr<scene>(s), binding });
+	}
+
+	void scene_manager::activate(scene* s, const scene_binding* binding, bool additive, bool initialized) {
+		if (additive) {
+			s->__set_index(s_activeScenes.size());
+			s_activeScenes.emplace_back(s, binding);
+		} else {
+			// destroy old scene
+			if (s_activeScenes.size() > 0) {
+				if (s_activeScenes[0].scene) deactivate(s_activeScenes[0]);
+			}
+			// no scenes, create empty first spot
+			else {
+				s_activeScenes.emplace_back(nullptr, nullptr);
+			}
+			s->__set_index(0);
+			s_activeScenes[0].scene.reset(s);
+			s_activeScenes[0].binding = binding;
+			s_activeScenes[0].profileName = profiler::intern(binding->name);
+			s_activeScenes[0].shouldDestroy = false;
+		}
+
+		if (initialized) {
+			for (entity_factory* factory : *s->__get_factories()) factory->__attach();
+			timers::resume_owned(s);
+			s->wake();
+			ALC_DEBUG_LOG("Woke scene " + binding->name);
+		} else {
+			init_scene(s, binding);
+			for (entity_factory* factory : *s->__get_factories()) factory->__attach();
+			ALC_DEBUG_LOG("Created scene " + binding->name);
+		}
+	}
+
+	void scene_manager::deactivate(active_scene& active) {
+		scene* s = active.scene.release();
+		if (active.binding->pooled) {
+			s->sleep();
+			park(s, active.binding);
+			ALC_DEBUG_LOG("Pooled scene " + active.binding->name);
+		} else {
+			s->exit();
+			delete s;
+			ALC_DEBUG_LOG("Closed scene " + active.binding->name);
+		}
+	}
+
+	void scene_manager::swap_in(scene_load* load) {
+		const scene_binding* binding = load->m_binding;
+		scene* loaded = load->m_scene.release();
+		loaded->__set_load(nullptr);
+
+		size_t index = static_cast<size_t>(-1);
+		if (load->m_preload && is_active_or_pooled(binding)) {
+			// loaded normally while this was preloading, dont keep a second copy
+			delete loaded;
+			loaded = nullptr;
+			ALC_DEBUG_LOG("Dropped preloaded scene " + binding->name);
+		} else if (load->m_preload) {
+			init_scene(loaded, binding);
+			park(loaded, binding);
+			ALC_DEBUG_LOG("Preloaded scene " + binding->name);
+		} else {
+			activate(loaded, binding, load->m_additive, load->m_pooled);
+			index = loaded->get_index();
+		}
+
+		load->m_active = loaded;
+		load->m_done.store(true, std::memory_order_release);
+		alice_events::post(scene_loaded_event{ loaded, binding->name, index });
+	}
+
+	void scene_manager::run_load(scene_load* load) {
+		ALC_PROFILE_SCOPE("scene_manager::run_load");
+		load->m_scene.reset(create_scene(load->m_binding, load, load->m_index));
+		load->m_loaded.store(true, std::memory_order_release);
+	}
+
+	void scene_manager::loader_main() {
+		while (true) {
+			std::shared_ptr<scene_load> load;
+			{
+				std::unique_lock<std::mutex> lock(s_loadLock);
+				s_loadSignal.wait(lock, [] { return s_stopLoading || s_loadQueue.size() > 0; });
+				if (s_stopLoading) return;
+				load = std::move(s_loadQueue.front());
+				s_loadQueue.pop_front();
+			}
+			run_load(load.get());
+		}
 	}
 
 	void scene_manager::__set_settings(const engine_settings* set) {
@@ -216,6 +595,24 @@ namespace alc {
 	}
 
 	void scene_manager::__exit() {
+		// a load that already started is finished before the loader stops
+		if (s_loader.joinable()) {
+			{
+				std::lock_guard<std::mutex> _(s_loadLock);
+				s_stopLoading = true;
+				s_loadQueue.clear();
+			}
+			s_loadSignal.notify_one();
+			s_loader.join();
+		}
+
+		// scenes that were never swapped in are destroyed, only exiting the ones that were initialized
+		for (auto& load : s_asyncLoads) {
+			if (load->m_pooled && load->m_scene) load->m_scene->exit();
+			load->m_scene.reset();
+		}
+		s_asyncLoads.clear();
+
 		// destroy all scenes
 		for (size_t i = 0; i < s_activeScenes.size(); i++) {
 			s_activeScenes[i].scene->exit();
@@ -223,6 +620,7 @@ namespace alc {
 			ALC_DEBUG_LOG("Closed scene " + s_activeScenes[i].binding->name);
 		}
 		s_activeScenes.clear();
+		clear_scene_pool();
 
 		// remove pointers
 		s_primarySceneToLoad = nullptr;
@@ -237,18 +635,24 @@ namespace alc {
 
 		// update scenes
 		for (size_t i = 0; i < s_activeScenes.size(); i++) {
+			ALC_PROFILE_SCOPE(s_activeScenes[i].profileName);
+			memory_arena::__set_current(s_activeScenes[i].scene->get_arena());
 			s_activeScenes[i].scene->update(ts);
 		}
+		memory_arena::__set_current(nullptr);
 	}
 
 	void scene_manager::__draw() {
 		// draw scenes
 		for (size_t i = 0; i < s_activeScenes.size(); i++) {
+			ALC_PROFILE_SCOPE(s_activeScenes[i].profileName);
+			memory_arena::__set_current(s_activeScenes[i].scene->get_arena());
 			s_activeScenes[i].scene->draw();
 		}
+		memory_arena::__set_current(nullptr);
 	}
 
 	scene_manager::active_scene::active_scene(alc::scene* scene_, const scene_binding* binding_)
-		: scene(scene_), shouldDestroy(false), binding(binding_) { }
+		: scene(scene_), shouldDestroy(false), binding(binding_), profileName(binding_ ? profiler::intern(binding_->name) : profile_name()) { }
 
 }
\ No newline at end of file
@@ -2,31 +2,75 @@
 #define ALC_CORE_SCENE_MANAGER_HPP
 #include "../common.hpp"
 #include "../datatypes/timestep.hpp"
+#include "../datatypes/memory_arena.hpp"
+#include "profiler.hpp"
+#include "timers.hpp"
+#include <atomic>
 
 namespace alc {
 
+	class entity_factory;
+	class scene_load;
+
 	// interface for scenes
 	class scene {
 	public:
 		virtual ~scene() = 0;
 		// events
+		// load runs before init, for scenes loaded with the _async functions it runs on the loader thread
+		// so assets and entities can be built there without stalling the frame
+		// entity_factories created in the constructor, load or init belong to the scene and are not updated
+		// until the scene is active, or while it is pooled
+		// other scenes, routines and event subscriptions should only be touched from init
+		virtual void load(const std::string& args) { }
 		virtual void init(const std::string& args) { }
 		virtual void exit() { }
+		// sleep is called instead of exit when the scene is parked in the pool
+		// wake is called instead of init when a pooled or preloaded scene becomes active
+		// routines and timers of the scene and its behaviors are suspended while pooled and continue after wake
+		virtual void sleep() { }
+		virtual void wake() { }
 		virtual void update(timestep ts) { }
 		virtual void draw() { }
 
 		// returns the index of this scene in the scene_manager
+		// it is already set in load, for scenes loaded in the background it is the index the scene gets
+		// once swapped in if the active scenes dont change before then
+		// preloaded and pooled scenes have an index of -1
 		size_t get_index() const;
 
 		// returns the name of this instance of this scene
 		std::string get_name() const;
 
+		// returns the arena the scene allocates from, null if the scene was not created by the scene_manager
+		// it is current on the thread while the scene is constructed, loaded, initialized, updated or drawn
+		// and is freed all at once after the scene is destroyed
+		memory_arena* get_arena();
+
+		// sets how far loading has gotten from 0 to 1, reported by the scene_load while loading in the background
+		// can be called from load on the loader thread
+		void set_load_progress(float progress);
+
+		// calls fn once after the delay in seconds, see timers
+		// the timer is cancelled when this scene is destroyed
+		timer_handle after(double seconds, const function<void>& fn);
+
+		// calls fn once after count updates, see timers
+		// the timer is cancelled when this scene is destroyed
+		timer_handle after_updates(uint64 count, const function<void>& fn);
+
 	private:
-		size_t m_index;
+		size_t m_index = static_cast<size_t>(-1);
 		std::string m_name;
+		scene_load* m_load = nullptr;
+		std::vector<entity_factory*> m_factories;
+		std::unique_ptr<memory_arena> m_arena; // destroyed after the members of the derived scene
 	public:
 		void __set_index(size_t index);
 		void __set_name(const std::string& name);
+		void __set_load(scene_load* load);
+		std::vector<entity_factory*>* __get_factories();
+		void __set_arena(std::unique_ptr<memory_arena>&& arena);
 	};
 
 	// binding for loading scenes
@@ -34,11 +78,71 @@ namespace alc {
 		std::string name = "";
 		scene* (*create)() = nullptr;
 		std::string args = "";
+		// when true, unloading the scene parks it in the pool instead of destroying it
+		bool pooled = false;
 	};
 
 	// create a binding for a scene
 	template<typename Ty>
-	scene_binding bind_scene(const std::string& name, const std::string& args = "");
+	scene_binding bind_scene(const std::string& name, const std::string& args = "", bool pooled = false);
+
+	// a scene loading in the background, returned by the _async functions
+	// the scene is swapped in on the engine's thread at the start of the first update after it finished loading
+	// progress can be polled, or scene_loaded_event can be awaited from a routine:
+	//     m_loading = scene_manager::load_scene_async("level_2");
+	//     ... draw m_loading->get_progress() ...
+	//     co_await wait_until<scene_loaded_event>([](const scene_loaded_event& ev) { return ev.name == "level_2"; });
+	class scene_load final {
+		ALC_NO_COPY(scene_load);
+		ALC_NO_MOVE(scene_load);
+		friend class scene;
+		friend class scene_manager;
+	public:
+		scene_load(const scene_binding* binding, bool additive, bool preload);
+		~scene_load();
+
+		// returns how far loading has gotten, from 0 to 1
+		float get_progress() const;
+
+		// returns true once the scene finished loading, it is swapped in during the next update
+		bool is_loaded() const;
+
+		// returns true once the scene was swapped in and initialized, or pooled if it was preloaded
+		bool is_done() const;
+
+		// returns the scene once it is done, otherwise null
+		scene* get_scene() const;
+
+		// returns the binding that is being loaded
+		const scene_binding* get_binding() const;
+
+		// returns true if the scene is loaded alongside the existing scenes
+		bool is_additive() const;
+
+		// returns true if the scene goes into the pool instead of becoming active
+		bool is_preload() const;
+
+	private:
+		const scene_binding* m_binding;
+		bool m_additive;
+		bool m_preload;
+		bool m_pooled; // taken from the pool, already initialized
+		size_t m_index; // set on the scene before it is loaded
+		std::unique_ptr<alc::scene> m_scene; // owned until it is swapped in
+		std::atomic<float> m_progress;
+		std::atomic<bool> m_loaded;
+		std::atomic<bool> m_done;
+		alc::scene* m_active;
+	};
+
+	// posted once a scene loaded with the _async functions was swapped in and initialized
+	// preloaded scenes have an index of -1, loaded is null if the preload was dropped because the scene
+	// became active or pooled while it was loading
+	struct scene_loaded_event final {
+		scene* loaded;
+		std::string name;
+		size_t index;
+	};
 
 	struct engine_settings;
 
@@ -59,6 +163,56 @@ namespace alc {
 		// loads a scene alongside the exiting scenes
 		static bool load_scene_additive(const std::string& sceneName);
 
+		// loads a scene into the primary slot on the loader thread, the old primary scene keeps running until it is swapped in
+		// returns null if there is no scene with the index
+		static std::shared_ptr<scene_load> load_scene_async(size_t sceneBindingIndex);
+
+		// loads a scene into the primary slot on the loader thread, the old primary scene keeps running until it is swapped in
+		// returns null if there is no scene with the name
+		static std::shared_ptr<scene_load> load_scene_async(const std::string& sceneName);
+
+		// loads a scene alongside the existing scenes on the loader thread
+		// returns null if there is no scene with the index
+		static std::shared_ptr<scene_load> load_scene_additive_async(size_t sceneBindingIndex);
+
+		// loads a scene alongside the existing scenes on the loader thread
+		// returns null if there is no scene with the name
+		static std::shared_ptr<scene_load> load_scene_additive_async(const std::string& sceneName);
+
+		// returns the number of scenes still loading or waiting to be swapped in
+		static size_t loading_scenes_size();
+
+		// pooling
+		// preloaded scenes and unloaded scenes with a pooled binding are kept in the pool, initialized but not updated or drawn
+		// loading a scene takes it from the pool and wakes it instead of creating it again
+
+		// creates, loads and initializes a scene and parks it in the pool
+		// returns false if the scene is already active, pooled or being preloaded
+		static bool preload_scene(size_t sceneBindingIndex);
+
+		// creates, loads and initializes a scene and parks it in the pool
+		// returns false if the scene is already active, pooled or being preloaded
+		static bool preload_scene(const std::string& sceneName);
+
+		// loads a scene on the loader thread, it is initialized and parked in the pool on the engine's thread
+		// returns null if there is no scene with the index or it is already active or pooled,
+		// returns the existing load if it is already being preloaded
+		static std::shared_ptr<scene_load> preload_scene_async(size_t sceneBindingIndex);
+
+		// loads a scene on the loader thread, it is initialized and parked in the pool on the engine's thread
+		// returns null if there is no scene with the name or it is already active or pooled,
+		// returns the existing load if it is already being preloaded
+		static std::shared_ptr<scene_load> preload_scene_async(const std::string& sceneName);
+
+		// returns the number of scenes in the pool
+		static size_t pooled_scenes_size();
+
+		// returns true if there is a scene in the pool for the name
+		static bool is_scene_pooled(const std::string& sceneName);
+
+		// exits and destroys every scene in the pool
+		static void clear_scene_pool();
+
 		// unloads and additive scene based off its index in the scene_manager
 		static bool unload_scene(size_t activeSceneIndex);
 
@@ -77,19 +231,41 @@ namespace alc {
 	private:
 
 		struct active_scene {
-			std::unique_ptr<scene> scene;
+			std::unique_ptr<alc::scene> scene;
 			bool shouldDestroy;
 			const scene_binding* binding;
+			profile_name profileName;
 			active_scene() = default;
 			active_scene(alc::scene* scene, const scene_binding* binding);
 		};
+		struct pooled_scene {
+			std::unique_ptr<alc::scene> scene;
+			const scene_binding* binding;
+		};
 		static inline std::vector<active_scene> s_activeScenes;
 		static inline const scene_binding* s_primarySceneToLoad = nullptr;
 		static inline std::vector<const scene_binding*> s_scenesToLoad;
 		static inline const engine_settings* s_eSettings = nullptr;
 		static inline bool s_checkForSceneChanges = false;
+		static inline std::vector<std::shared_ptr<scene_load>> s_asyncLoads; // in the order they were requested
+		static inline std::vector<pooled_scene> s_pooledScenes;
 
 		static void handle_scenes();
+		static const scene_binding* find_binding(size_t sceneBindingIndex);
+		static const scene_binding* find_binding(const std::string& sceneName);
+		static std::shared_ptr<scene_load> load_async(const scene_binding* binding, bool additive, bool preload);
+		static scene* create_scene(const scene_binding* binding, scene_load* load, size_t index);
+		static bool preload(const scene_binding* binding);
+		static bool is_active_or_pooled(const scene_binding* binding);
+		static std::shared_ptr<scene_load> find_preload(const scene_binding* binding);
+		static void init_scene(scene* s, const scene_binding* binding);
+		static scene* take_pooled(const scene_binding* binding);
+		static void park(scene* s, const scene_binding* binding);
+		static void activate(scene* s, const scene_binding* binding, bool additive, bool initialized);
+		static void deactivate(active_scene& active);
+		static void swap_in(scene_load* load);
+		static void run_load(scene_load* load);
+		static void loader_main();
 
 	public:
 		static void __set_settings(const engine_settings* set);
@@ -103,11 +279,12 @@ namespace alc {
 	// implementations
 
 	template<typename Ty>
-	inline scene_binding bind_scene(const std::string& name, const std::string& args) {
+	inline scene_binding bind_scene(const std::string& name, const std::string& args, bool pooled) {
 		scene_binding sb;
 		sb.name = name;
 		sb.create = []()-> scene* { return new Ty(); };
 		sb.args = args;
+		sb.pooled = pooled;
 		return sb;
 
 	}
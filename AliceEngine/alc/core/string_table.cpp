@@ -0,0 +1,82 @@
+#include "string_table.hpp"
+#include "debug.hpp"
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace alc {
+
+	namespace {
+
+		// map nodes never move so views into the strings stay valid
+		std::shared_mutex s_lock;
+		std::unordered_map<uint32, std::string> s_strings32;
+		std::unordered_map<uint64, std::string> s_strings64;
+		std::unordered_set<std::string> s_collided; // strings that lost to another string with their hash
+
+		template<typename Key>
+		void insert(std::unordered_map<Key, std::string>& strings, Key hash, std::string_view str) {
+			// most strings are interned many times so check without the exclusive lock first
+			{
+				std::shared_lock<std::shared_mutex> _(s_lock);
+				auto it = strings.find(hash);
+				if (it != strings.end() && (it->second == str || s_collided.contains(std::string(str)))) return;
+			}
+
+			std::unique_lock<std::shared_mutex> _(s_lock);
+			auto [it, inserted] = strings.try_emplace(hash, str);
+			if (inserted || it->second == str) return;
+
+			// keep the first string so earlier lookups stay the same, each colliding string is only counted once
+			if (!s_collided.emplace(str).second) return;
+			ALC_DEBUG_WARNING("Hash collision between \"" + std::string(str) + "\" and \"" + it->second + "\"");
+		}
+
+		template<typename Key>
+		std::string_view find(const std::unordered_map<Key, std::string>& strings, Key hash) {
+			std::shared_lock<std::shared_mutex> _(s_lock);
+			auto it = strings.find(hash);
+			return it == strings.end() ? std::string_view() : std::string_view(it->second);
+		}
+
+	}
+
+	hash32_t string_table::intern(std::string_view str) {
+		const hash32_t hash = hash_string<hash32_t>(str);
+		if constexpr (enabled) insert(s_strings32, static_cast<uint32>(hash), str);
+		return hash;
+	}
+
+	hash64_t string_table::intern64(std::string_view str) {
+		const hash64_t hash = hash_string<hash64_t>(str);
+		if constexpr (enabled) insert(s_strings64, static_cast<uint64>(hash), str);
+		return hash;
+	}
+
+	std::string_view string_table::lookup(hash32_t hash) {
+		return find(s_strings32, static_cast<uint32>(hash));
+	}
+
+	std::string_view string_table::lookup(hash64_t hash) {
+		return find(s_strings64, static_cast<uint64>(hash));
+	}
+
+	size_t string_table::get_collision_count() {
+		std::shared_lock<std::shared_mutex> _(s_lock);
+		return s_collided.size();
+	}
+
+	size_t string_table::size() {
+		std::shared_lock<std::shared_mutex> _(s_lock);
+		return s_strings32.size() + s_strings64.size();
+	}
+
+	void string_table::clear() {
+		std::unique_lock<std::shared_mutex> _(s_lock);
+		s_strings32.clear();
+		s_strings64.clear();
+		s_collided.clear();
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef ALC_CORE_STRING_TABLE_HPP
+#define ALC_CORE_STRING_TABLE_HPP
+#include "../common.hpp"
+#include "../datatypes/hash.hpp"
+
+// keeps the string behind every interned hash so hashes can be turned back into text
+// on by default in debug builds, define it as 0 or 1 in the project settings to choose
+#ifndef ALC_STRING_TABLE
+#ifdef _DEBUG
+#define ALC_STRING_TABLE 1
+#else
+#define ALC_STRING_TABLE 0
+#endif
+#endif
+
+namespace alc {
+
+	// static thread safe table of interned strings
+	// interning hashes the string the same way as hash_string and "..."_h,
+	// when the table is enabled it also remembers the string and warns if two different strings share a hash
+	// when it is disabled interning is only hashing and lookups return nothing
+	// strings are kept until clear is called so the table only grows, strings built at runtime
+	// such as entity names add an entry for every distinct string
+	class string_table final {
+		ALC_STATIC_CLASS(string_table);
+	public:
+
+		// true if strings are being kept
+		static constexpr bool enabled = ALC_STRING_TABLE != 0;
+
+		// hashes the string and remembers it
+		static hash32_t intern(std::string_view str);
+
+		// hashes the string and remembers it
+		static hash64_t intern64(std::string_view str);
+
+		// returns the string that was interned with the hash
+		// empty if it was never interned or the table is disabled
+		// the view stays valid until the table is cleared
+		static std::string_view lookup(hash32_t hash);
+
+		// returns the string that was interned with the hash
+		// empty if it was never interned or the table is disabled
+		// the view stays valid until the table is cleared
+		static std::string_view lookup(hash64_t hash);
+
+		// returns the number of distinct strings that collided with a different string already in the table
+		static size_t get_collision_count();
+
+		// returns the number of interned strings
+		static size_t size();
+
+		// forgets every interned string
+		static void clear();
+	};
+
+}
+
+#endif // !ALC_CORE_STRING_TABLE_HPP
\ No newline at end of file
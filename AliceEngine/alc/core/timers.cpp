@@ -0,0 +1,176 @@
+#include "timers.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+
+namespace alc {
+
+	namespace {
+
+		// handles of the update wheel have the top bit of their index set
+		constexpr uint32 update_bit = 1u << 31;
+
+		std::mutex s_lock;
+		timer_wheel s_timeWheel;
+		timer_wheel s_updateWheel;
+		double s_time = 0.0;
+
+		// reused every update, callbacks are called outside of the lock so they can schedule more timers
+		std::vector<function<void>> s_expired;
+
+		// the timers given an owner, fired timers are removed lazily
+		struct owned final {
+			std::vector<timer_handle> handles;
+			bool paused = false; // new timers start paused
+		};
+		std::unordered_map<const void*, owned> s_owned;
+		std::atomic_size_t s_ownerCount = 0; // lets cancel_owned skip the lock when nothing has an owner
+
+		timer_handle to_update_handle(timer_handle handle) {
+			handle.index |= update_bit;
+			return handle;
+		}
+
+		// must hold s_lock
+		bool find(timer_handle handle, timer_wheel*& wheel, timer_handle& local) {
+			if (handle.is_null()) return false;
+			local = handle;
+			local.index &= ~update_bit;
+			wheel = (handle.index & update_bit) ? &s_updateWheel : &s_timeWheel;
+			return true;
+		}
+
+		// must hold s_lock
+		bool pending(timer_handle handle) {
+			timer_wheel* wheel;
+			timer_handle local;
+			return find(handle, wheel, local) && wheel->is_pending(local);
+		}
+
+		// must hold s_lock
+		timer_handle add_owned(const void* owner, timer_handle handle) {
+			if (owner == nullptr) return handle;
+			auto [it, added] = s_owned.try_emplace(owner);
+			if (added) s_ownerCount.store(s_owned.size(), std::memory_order_relaxed);
+			std::vector<timer_handle>& handles = it->second.handles;
+			// drop fired timers before growing so owners that keep scheduling dont grow forever
+			if (handles.size() == handles.capacity()) {
+				handles.erase(std::remove_if(handles.begin(), handles.end(), [](timer_handle h) { return !pending(h); }), handles.end());
+			}
+			handles.push_back(handle);
+			if (it->second.paused) {
+				timer_wheel* wheel;
+				timer_handle local;
+				if (find(handle, wheel, local)) wheel->pause(local);
+			}
+			return handle;
+		}
+
+	}
+
+	timer_handle timers::after(double seconds, const function<void>& fn, const void* owner) {
+		std::lock_guard<std::mutex> _(s_lock);
+		// always at least one tick away so it never fires in the update it was made in
+		const uint64 ticks = std::max<uint64>(static_cast<uint64>(std::ceil(std::max(seconds, 0.0) / resolution)), 1);
+		return add_owned(owner, s_timeWheel.schedule(s_timeWheel.get_tick() + ticks, fn));
+	}
+
+	timer_handle timers::after_updates(uint64 count, const function<void>& fn, const void* owner) {
+		std::lock_guard<std::mutex> _(s_lock);
+		return add_owned(owner, to_update_handle(s_updateWheel.schedule(s_updateWheel.get_tick() + std::max<uint64>(count, 1), fn)));
+	}
+
+	bool timers::cancel(timer_handle& handle) {
+		std::lock_guard<std::mutex> _(s_lock);
+		timer_wheel* wheel;
+		timer_handle local;
+		const bool cancelled = find(handle, wheel, local) && wheel->cancel(local);
+		handle = timer_handle();
+		return cancelled;
+	}
+
+	size_t timers::cancel_owned(const void* owner) {
+		if (s_ownerCount.load(std::memory_order_relaxed) == 0) return 0;
+		std::lock_guard<std::mutex> _(s_lock);
+		auto it = s_owned.find(owner);
+		if (it == s_owned.end()) return 0;
+		size_t count = 0;
+		for (timer_handle handle : it->second.handles) {
+			timer_wheel* wheel;
+			timer_handle local;
+			if (find(handle, wheel, local) && wheel->cancel(local)) ++count;
+		}
+		s_owned.erase(it);
+		s_ownerCount.store(s_owned.size(), std::memory_order_relaxed);
+		return count;
+	}
+
+	void timers::pause_owned(const void* owner) {
+		if (owner == nullptr) return;
+		std::lock_guard<std::mutex> _(s_lock);
+		auto [it, added] = s_owned.try_emplace(owner);
+		if (added) s_ownerCount.store(s_owned.size(), std::memory_order_relaxed);
+		it->second.paused = true;
+		for (timer_handle handle : it->second.handles) {
+			timer_wheel* wheel;
+			timer_handle local;
+			if (find(handle, wheel, local)) wheel->pause(local);
+		}
+	}
+
+	void timers::resume_owned(const void* owner) {
+		if (s_ownerCount.load(std::memory_order_relaxed) == 0) return;
+		std::lock_guard<std::mutex> _(s_lock);
+		auto it = s_owned.find(owner);
+		if (it == s_owned.end()) return;
+		for (timer_handle handle : it->second.handles) {
+			timer_wheel* wheel;
+			timer_handle local;
+			if (find(handle, wheel, local)) wheel->resume(local);
+		}
+		it->second.paused = false;
+		if (it->second.handles.empty()) {
+			s_owned.erase(it);
+			s_ownerCount.store(s_owned.size(), std::memory_order_relaxed);
+		}
+	}
+
+	bool timers::is_pending(timer_handle handle) {
+		std::lock_guard<std::mutex> _(s_lock);
+		return pending(handle);
+	}
+
+	size_t timers::size() {
+		std::lock_guard<std::mutex> _(s_lock);
+		return s_timeWheel.size() + s_updateWheel.size();
+	}
+
+	double timers::get_time() {
+		std::lock_guard<std::mutex> _(s_lock);
+		return s_time;
+	}
+
+	void timers::__update(timestep ts) {
+		ALC_PROFILE_SCOPE("timers::__update");
+		{
+			std::lock_guard<std::mutex> _(s_lock);
+			s_time += ts.get();
+			s_updateWheel.advance(s_updateWheel.get_tick() + 1, &s_expired);
+			s_timeWheel.advance(static_cast<uint64>(s_time / resolution), &s_expired);
+		}
+		for (auto& fn : s_expired) fn();
+		s_expired.clear();
+	}
+
+	void timers::__clear() {
+		std::lock_guard<std::mutex> _(s_lock);
+		s_timeWheel.clear();
+		s_updateWheel.clear();
+		s_owned.clear();
+		s_ownerCount.store(0, std::memory_order_relaxed);
+	}
+
+}
\ No newline at end of file
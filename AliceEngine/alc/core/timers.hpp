@@ -0,0 +1,70 @@
+#ifndef ALC_CORE_TIMERS_HPP
+#define ALC_CORE_TIMERS_HPP
+#include "../common.hpp"
+#include "../datatypes/function.hpp"
+#include "../datatypes/timestep.hpp"
+#include "../datatypes/timer_wheel.hpp"
+
+namespace alc {
+
+	// static timer service driven by the engine once per update
+	// callbacks are called once on the engine's thread at the start of the update they become due in,
+	// instead of counting down every frame:
+	//     m_cooldown = timers::after(2.0, [this] { m_canAttack = true; });
+	// callbacks that capture something should be cancelled when it is destroyed, or given it as their owner
+	// timers owned by a behavior or scene are cancelled when it is destroyed
+	class timers final {
+		ALC_STATIC_CLASS(timers);
+	public:
+
+		// the length of a tick of the time wheel in seconds, delays are rounded up to it
+		static constexpr double resolution = 0.001;
+
+		// calls fn once after the delay in seconds
+		// the timer is cancelled by cancel_owned(owner) if an owner is given
+		// can be called from any thread
+		static timer_handle after(double seconds, const function<void>& fn, const void* owner = nullptr);
+
+		// calls fn once after count updates, fixed ticks when the engine uses a fixed timestep
+		// the timer is cancelled by cancel_owned(owner) if an owner is given
+		// can be called from any thread
+		static timer_handle after_updates(uint64 count, const function<void>& fn, const void* owner = nullptr);
+
+		// stops the timer from being called and clears the handle
+		// returns false if it was already called or cancelled
+		// can be called from any thread
+		static bool cancel(timer_handle& handle);
+
+		// cancels every waiting timer with the owner
+		// returns the number of timers cancelled
+		// can be called from any thread
+		static size_t cancel_owned(const void* owner);
+
+		// stops every timer with the owner from counting down until resume_owned is called,
+		// including timers given to the owner while it is paused
+		// can be called from any thread
+		static void pause_owned(const void* owner);
+
+		// lets the paused timers with the owner count down the time they had left
+		// can be called from any thread
+		static void resume_owned(const void* owner);
+
+		// returns true if the timer is still waiting, paused timers are waiting
+		static bool is_pending(timer_handle handle);
+
+		// returns the number of waiting timers
+		static size_t size();
+
+		// returns the time in seconds the timers have been updated for
+		static double get_time();
+
+		// calls every timer that is due
+		static void __update(timestep ts);
+
+		// cancels every timer
+		static void __clear();
+	};
+
+}
+
+#endif // !ALC_CORE_TIMERS_HPP
\ No newline at end of file
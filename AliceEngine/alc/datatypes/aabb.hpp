@@ -0,0 +1,105 @@
+#ifndef ALC_DATATYPES_AABB_HPP
+#define ALC_DATATYPES_AABB_HPP
+#include "../common.hpp"
+#include <algorithm>
+
+namespace alc {
+
+	// axis aligned bounding box
+	struct aabb final {
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+
+		// creates a box around a sphere
+		static aabb from_sphere(const glm::vec3& center, float radius);
+
+		// returns the smallest box that holds both boxes
+		static aabb merge(const aabb& lhs, const aabb& rhs);
+
+		// returns the box grown by amount in every direction
+		aabb expanded(float amount) const;
+
+		// returns true if the boxes touch
+		bool overlaps(const aabb& other) const;
+
+		// returns true if other is completely inside of this
+		bool contains(const aabb& other) const;
+
+		// returns the surface area, used to decide how to build trees
+		float surface_area() const;
+
+		// returns the squared distance from the point to the box, 0 if inside
+		float distance2(const glm::vec3& point) const;
+
+		// finds where the ray enters the box
+		// inverseDirection is 1 / direction, returns false if it misses or enters after maxDistance
+		bool raycast(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float* distance) const;
+	};
+
+
+	// implementations
+
+	inline aabb aabb::from_sphere(const glm::vec3& center, float radius) {
+		return aabb{ center - glm::vec3(radius), center + glm::vec3(radius) };
+	}
+
+	inline aabb aabb::merge(const aabb& lhs, const aabb& rhs) {
+		aabb result;
+		for (int i = 0; i < 3; i++) {
+			result.min[i] = std::min(lhs.min[i], rhs.min[i]);
+			result.max[i] = std::max(lhs.max[i], rhs.max[i]);
+		}
+		return result;
+	}
+
+	inline aabb aabb::expanded(float amount) const {
+		return aabb{ min - glm::vec3(amount), max + glm::vec3(amount) };
+	}
+
+	inline bool aabb::overlaps(const aabb& other) const {
+		for (int i = 0; i < 3; i++) {
+			if (max[i] < other.min[i] || min[i] > other.max[i]) return false;
+		}
+		return true;
+	}
+
+	inline bool aabb::contains(const aabb& other) const {
+		for (int i = 0; i < 3; i++) {
+			if (other.min[i] < min[i] || other.max[i] > max[i]) return false;
+		}
+		return true;
+	}
+
+	inline float aabb::surface_area() const {
+		const glm::vec3 size = max - min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	inline float aabb::distance2(const glm::vec3& point) const {
+		float result = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			const float d = std::max(std::max(min[i] - point[i], 0.0f), point[i] - max[i]);
+			result += d * d;
+		}
+		return result;
+	}
+
+	inline bool aabb::raycast(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float* distance) const {
+		// slab test
+		float enter = 0.0f;
+		float exit = maxDistance;
+		for (int i = 0; i < 3; i++) {
+			float t0 = (min[i] - origin[i]) * inverseDirection[i];
+			float t1 = (max[i] - origin[i]) * inverseDirection[i];
+			if (t0 > t1) std::swap(t0, t1);
+			enter = std::max(enter, t0);
+			exit = std::min(exit, t1);
+			if (enter > exit) return false;
+		}
+		if (distance) *distance = enter;
+		return true;
+	}
+
+}
+
+#endif // !ALC_DATATYPES_AABB_HPP
\ No newline at end of file
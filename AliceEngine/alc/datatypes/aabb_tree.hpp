@@ -0,0 +1,371 @@
+#ifndef ALC_DATATYPES_AABB_TREE_HPP
+#define ALC_DATATYPES_AABB_TREE_HPP
+#include "../common.hpp"
+#include "aabb.hpp"
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace alc {
+
+	// dynamic bounding volume hierarchy
+	// leaves store a box grown by a margin so items can move a little without the tree changing,
+	// inserts pick the sibling that grows the tree the least and rotations keep it balanced
+	// queries only read and can run on many threads at once
+	class aabb_tree final {
+	public:
+
+		aabb_tree(float margin = 0.5f);
+
+		// adds an item, ids should be small since they index an array
+		void insert(uint32 id, const aabb& bounds);
+
+		// moves an item, only changes the tree if it left its grown box
+		void update(uint32 id, const aabb& bounds);
+
+		// removes an item
+		void remove(uint32 id);
+
+		// returns the number of items
+		size_t size() const;
+
+		// returns the height of the tree
+		int32 get_height() const;
+
+		// calls fn(id) for every item whose grown box overlaps the box
+		template<typename Fn> void query(const aabb& box, Fn&& fn) const;
+
+		// calls fn(id) for every item whose grown box the ray enters
+		// fn returns the new max distance so the search can stop early
+		template<typename Fn> void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Fn&& fn) const;
+
+		// calls fn(id) for items in order of the distance from the point to their grown box
+		// fn returns the squared radius that is still being searched, items outside of it are skipped
+		template<typename Fn> void nearest(const glm::vec3& point, Fn&& fn) const;
+
+	private:
+		static constexpr int32 null_node = -1;
+
+		struct node final {
+			aabb box;
+			int32 parent;
+			int32 left;
+			int32 right;
+			int32 height; // 0 for leaves, -1 for free nodes
+			uint32 id;
+
+			bool is_leaf() const { return left == null_node; }
+		};
+
+		// the nodes left to visit while walking the tree
+		// only allocates once the tree is deeper than balancing normally lets it get
+		class node_stack final {
+		public:
+			void push(int32 index);
+			int32 pop();
+			bool empty() const;
+		private:
+			static constexpr size_t fixed_size = 64;
+			int32 m_fixed[fixed_size];
+			std::vector<int32> m_overflow;
+			size_t m_count = 0;
+		};
+
+		std::vector<node> m_nodes;
+		int32 m_root;
+		int32 m_free; // free nodes are linked through parent
+		std::vector<int32> m_leaves; // indexed by id
+		float m_margin;
+		size_t m_size;
+
+		int32 allocate_node();
+		void free_node(int32 index);
+		void insert_leaf(int32 leaf);
+		void remove_leaf(int32 leaf);
+		void refit(int32 index);
+		int32 balance(int32 index);
+	};
+
+
+	// implementations
+
+	inline aabb_tree::aabb_tree(float margin) : m_root(null_node), m_free(null_node), m_margin(margin), m_size(0) { }
+
+	inline void aabb_tree::insert(uint32 id, const aabb& bounds) {
+		if (id >= m_leaves.size()) m_leaves.resize(id + 1, null_node);
+		if (m_leaves[id] != null_node) {
+			update(id, bounds);
+			return;
+		}
+		const int32 leaf = allocate_node();
+		m_nodes[leaf].box = bounds.expanded(m_margin);
+		m_nodes[leaf].id = id;
+		m_nodes[leaf].height = 0;
+		m_leaves[id] = leaf;
+		insert_leaf(leaf);
+		++m_size;
+	}
+
+	inline void aabb_tree::update(uint32 id, const aabb& bounds) {
+		const int32 leaf = m_leaves[id];
+		if (m_nodes[leaf].box.contains(bounds)) return;
+		remove_leaf(leaf);
+		m_nodes[leaf].box = bounds.expanded(m_margin);
+		insert_leaf(leaf);
+	}
+
+	inline void aabb_tree::remove(uint32 id) {
+		if (id >= m_leaves.size() || m_leaves[id] == null_node) return;
+		const int32 leaf = m_leaves[id];
+		remove_leaf(leaf);
+		free_node(leaf);
+		m_leaves[id] = null_node;
+		--m_size;
+	}
+
+	inline void aabb_tree::node_stack::push(int32 index) {
+		if (m_count < fixed_size) m_fixed[m_count] = index;
+		else m_overflow.push_back(index);
+		++m_count;
+	}
+
+	inline int32 aabb_tree::node_stack::pop() {
+		--m_count;
+		if (m_count < fixed_size) return m_fixed[m_count];
+		const int32 index = m_overflow.back();
+		m_overflow.pop_back();
+		return index;
+	}
+
+	inline bool aabb_tree::node_stack::empty() const {
+		return m_count == 0;
+	}
+
+	inline size_t aabb_tree::size() const {
+		return m_size;
+	}
+
+	inline int32 aabb_tree::get_height() const {
+		return m_root == null_node ? 0 : m_nodes[m_root].height;
+	}
+
+	template<typename Fn>
+	inline void aabb_tree::query(const aabb& box, Fn&& fn) const {
+		if (m_root == null_node) return;
+		node_stack stack;
+		stack.push(m_root);
+		while (!stack.empty()) {
+			const node& n = m_nodes[stack.pop()];
+			if (!n.box.overlaps(box)) continue;
+			if (n.is_leaf()) {
+				fn(n.id);
+			} else {
+				stack.push(n.left);
+				stack.push(n.right);
+			}
+		}
+	}
+
+	template<typename Fn>
+	inline void aabb_tree::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Fn&& fn) const {
+		if (m_root == null_node) return;
+		const float inf = std::numeric_limits<float>::infinity();
+		glm::vec3 inverse;
+		for (int i = 0; i < 3; i++) inverse[i] = direction[i] != 0.0f ? 1.0f / direction[i] : inf;
+
+		node_stack stack;
+		stack.push(m_root);
+		while (!stack.empty()) {
+			const node& n = m_nodes[stack.pop()];
+			float distance;
+			if (!n.box.raycast(origin, inverse, maxDistance, &distance)) continue;
+			if (n.is_leaf()) {
+				maxDistance = std::min(maxDistance, fn(n.id));
+				continue;
+			}
+
+			// visit the nearer child first so the max distance shrinks sooner
+			float leftDistance = inf, rightDistance = inf;
+			const bool hitLeft = m_nodes[n.left].box.raycast(origin, inverse, maxDistance, &leftDistance);
+			const bool hitRight = m_nodes[n.right].box.raycast(origin, inverse, maxDistance, &rightDistance);
+			if (hitLeft && hitRight) {
+				stack.push(leftDistance < rightDistance ? n.right : n.left);
+				stack.push(leftDistance < rightDistance ? n.left : n.right);
+			} else if (hitLeft) {
+				stack.push(n.left);
+			} else if (hitRight) {
+				stack.push(n.right);
+			}
+		}
+	}
+
+	template<typename Fn>
+	inline void aabb_tree::nearest(const glm::vec3& point, Fn&& fn) const {
+		if (m_root == null_node) return;
+
+		// best first, closest box on top
+		using candidate = std::pair<float, int32>;
+		std::priority_queue<candidate, std::vector<candidate>, std::greater<candidate>> open;
+		open.emplace(m_nodes[m_root].box.distance2(point), m_root);
+		float radius2 = std::numeric_limits<float>::infinity();
+		while (open.size() > 0) {
+			const auto [distance2, index] = open.top();
+			open.pop();
+			if (distance2 > radius2) return;
+			const node& n = m_nodes[index];
+			if (n.is_leaf()) {
+				radius2 = fn(n.id);
+				continue;
+			}
+			open.emplace(m_nodes[n.left].box.distance2(point), n.left);
+			open.emplace(m_nodes[n.right].box.distance2(point), n.right);
+		}
+	}
+
+	inline int32 aabb_tree::allocate_node() {
+		if (m_free == null_node) {
+			m_nodes.push_back(node{ aabb(), null_node, null_node, null_node, -1, 0 });
+			return static_cast<int32>(m_nodes.size() - 1);
+		}
+		const int32 index = m_free;
+		m_free = m_nodes[index].parent;
+		m_nodes[index] = node{ aabb(), null_node, null_node, null_node, -1, 0 };
+		return index;
+	}
+
+	inline void aabb_tree::free_node(int32 index) {
+		m_nodes[index].parent = m_free;
+		m_nodes[index].height = -1;
+		m_free = index;
+	}
+
+	inline void aabb_tree::insert_leaf(int32 leaf) {
+		if (m_root == null_node) {
+			m_root = leaf;
+			m_nodes[leaf].parent = null_node;
+			return;
+		}
+
+		// walk down towards the sibling that costs the least to pair with
+		const aabb box = m_nodes[leaf].box;
+		int32 index = m_root;
+		while (!m_nodes[index].is_leaf()) {
+			const node& n = m_nodes[index];
+			const float area = n.box.surface_area();
+			const float combined = aabb::merge(n.box, box).surface_area();
+
+			// making a new parent here versus pushing the leaf further down
+			const float cost = 2.0f * combined;
+			const float inherited = 2.0f * (combined - area);
+			auto descend_cost = [&](int32 child) {
+				const aabb merged = aabb::merge(m_nodes[child].box, box);
+				if (m_nodes[child].is_leaf()) return merged.surface_area() + inherited;
+				return merged.surface_area() - m_nodes[child].box.surface_area() + inherited;
+			};
+			const float leftCost = descend_cost(n.left);
+			const float rightCost = descend_cost(n.right);
+			if (cost < leftCost && cost < rightCost) break;
+			index = leftCost < rightCost ? n.left : n.right;
+		}
+
+		// pair the leaf with the sibling under a new parent
+		const int32 sibling = index;
+		const int32 oldParent = m_nodes[sibling].parent;
+		const int32 newParent = allocate_node();
+		m_nodes[newParent].parent = oldParent;
+		m_nodes[newParent].box = aabb::merge(box, m_nodes[sibling].box);
+		m_nodes[newParent].height = m_nodes[sibling].height + 1;
+		m_nodes[newParent].left = sibling;
+		m_nodes[newParent].right = leaf;
+		m_nodes[sibling].parent = newParent;
+		m_nodes[leaf].parent = newParent;
+		if (oldParent == null_node) {
+			m_root = newParent;
+		} else if (m_nodes[oldParent].left == sibling) {
+			m_nodes[oldParent].left = newParent;
+		} else {
+			m_nodes[oldParent].right = newParent;
+		}
+
+		refit(m_nodes[leaf].parent);
+	}
+
+	inline void aabb_tree::remove_leaf(int32 leaf) {
+		if (leaf == m_root) {
+			m_root = null_node;
+			return;
+		}
+
+		// the sibling takes the parent's place
+		const int32 parent = m_nodes[leaf].parent;
+		const int32 grandParent = m_nodes[parent].parent;
+		const int32 sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+		free_node(parent);
+		if (grandParent == null_node) {
+			m_root = sibling;
+			m_nodes[sibling].parent = null_node;
+			return;
+		}
+		if (m_nodes[grandParent].left == parent) m_nodes[grandParent].left = sibling;
+		else m_nodes[grandParent].right = sibling;
+		m_nodes[sibling].parent = grandParent;
+		refit(grandParent);
+	}
+
+	inline void aabb_tree::refit(int32 index) {
+		// fix the boxes and heights up to the root, balancing on the way
+		while (index != null_node) {
+			index = balance(index);
+			node& n = m_nodes[index];
+			n.height = 1 + std::max(m_nodes[n.left].height, m_nodes[n.right].height);
+			n.box = aabb::merge(m_nodes[n.left].box, m_nodes[n.right].box);
+			index = n.parent;
+		}
+	}
+
+	inline int32 aabb_tree::balance(int32 a) {
+		// rotates the taller child up if the children differ in height by more than one
+		if (m_nodes[a].is_leaf() || m_nodes[a].height < 2) return a;
+		const int32 b = m_nodes[a].left;
+		const int32 c = m_nodes[a].right;
+		const int32 difference = m_nodes[c].height - m_nodes[b].height;
+		if (difference >= -1 && difference <= 1) return a;
+
+		// the taller child becomes the parent of a
+		const int32 up = difference > 0 ? c : b;
+		const int32 stay = difference > 0 ? b : c;
+		const int32 f = m_nodes[up].left;
+		const int32 g = m_nodes[up].right;
+
+		m_nodes[up].left = a;
+		m_nodes[up].parent = m_nodes[a].parent;
+		m_nodes[a].parent = up;
+		if (m_nodes[up].parent == null_node) {
+			m_root = up;
+		} else if (m_nodes[m_nodes[up].parent].left == a) {
+			m_nodes[m_nodes[up].parent].left = up;
+		} else {
+			m_nodes[m_nodes[up].parent].right = up;
+		}
+
+		// the taller grandchild stays with up, the other one moves under a
+		const bool keepF = m_nodes[f].height > m_nodes[g].height;
+		const int32 kept = keepF ? f : g;
+		const int32 moved = keepF ? g : f;
+		m_nodes[up].right = kept;
+		m_nodes[a].left = stay;
+		m_nodes[a].right = moved;
+		m_nodes[moved].parent = a;
+
+		node& na = m_nodes[a];
+		na.box = aabb::merge(m_nodes[na.left].box, m_nodes[na.right].box);
+		na.height = 1 + std::max(m_nodes[na.left].height, m_nodes[na.right].height);
+		node& nu = m_nodes[up];
+		nu.box = aabb::merge(m_nodes[nu.left].box, m_nodes[nu.right].box);
+		nu.height = 1 + std::max(m_nodes[nu.left].height, m_nodes[nu.right].height);
+		return up;
+	}
+
+}
+
+#endif // !ALC_DATATYPES_AABB_TREE_HPP
\ No newline at end of file
@@ -24,9 +24,12 @@
 
 #ifndef ALC_FUNCTION_HPP
 #define ALC_FUNCTION_HPP
+#include "../common.hpp"
 #include <tuple>
-#include <memory>
-#include <list>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
 
 namespace alc {
 
@@ -77,6 +80,9 @@ namespace alc {
 	}
 
 	// template definition
+	// callables that fit into storage_size are stored inline, larger ones are heap allocated
+	// function pointers and member bindings compare equal to copies of themselves,
+	// any other callable only compares equal to itself
 	template<typename _RetTy, typename... ArgsTy>
 	struct function {
 
@@ -84,23 +90,57 @@ namespace alc {
 		using funcsigty = returnty(*)(ArgsTy...);
 		using arguments = std::tuple<ArgsTy...>;
 
+		// the max size of a callable that is stored without allocating
+		static constexpr size_t storage_size = 4 * sizeof(void*);
+
 		constexpr function(std::nullptr_t = nullptr)
-			: m_instance(nullptr), m_function(nullptr), m_invokeable(nullptr) { }
+			: m_storage{ }, m_invoke(nullptr), m_manage(nullptr), m_comparable(false) { }
 
-		template<typename T>
-		function(T lambda)
-			: m_instance(nullptr), m_function(), m_invokeable(nullptr) {
-			bind(lambda);
+		template<typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, function>>>
+		function(T&& lambda)
+			: m_storage{ }, m_invoke(nullptr), m_manage(nullptr), m_comparable(false) {
+			bind(std::forward<T>(lambda));
+		}
+
+		function(const function& other)
+			: m_storage{ }, m_invoke(nullptr), m_manage(nullptr), m_comparable(false) {
+			copy_from(other);
+		}
+
+		function(function&& other) noexcept
+			: m_storage{ }, m_invoke(nullptr), m_manage(nullptr), m_comparable(false) {
+			move_from(other);
+		}
+
+		function& operator=(const function& other) {
+			if (this != &other) {
+				unbind();
+				copy_from(other);
+			}
+			return *this;
+		}
+
+		function& operator=(function&& other) noexcept {
+			if (this != &other) {
+				unbind();
+				move_from(other);
+			}
+			return *this;
+		}
+
+		~function() {
+			unbind();
 		}
 
 		operator bool() const {
-			return m_instance != nullptr || m_function != nullptr || m_invokeable.get() != nullptr;
+			return m_invoke != nullptr;
 		}
 
 		bool operator==(const function& other) const {
-			if (m_instance)		 return this->m_instance == other.m_instance && this->m_memberbinding == other.m_memberbinding;
-			else if (m_function) return this->m_function == other.m_function;
-			else				 return this->m_invokeable.get() == other.m_invokeable.get();
+			if (this == &other) return true;
+			if (!m_comparable || !other.m_comparable) return false;
+			// the invoker is unique per bound function/member and the first pointer holds the instance
+			return m_invoke == other.m_invoke && std::memcmp(m_storage, other.m_storage, sizeof(void*)) == 0;
 		}
 
 		bool operator!=(const function& other) const {
@@ -108,106 +148,151 @@ namespace alc {
 		}
 
 		void unbind() {
-			m_invokeable.reset();
-			m_instance = nullptr;
-			m_function = nullptr;
-			m_memberbinding = nullptr;
+			if (m_manage) m_manage(manage_op::destroy, this, nullptr);
+			// comparisons read the storage, dont leave bytes from the last callable behind
+			std::memset(m_storage, 0, storage_size);
+			m_invoke = nullptr;
+			m_manage = nullptr;
+			m_comparable = false;
 		}
 
 		template<funcsigty Function>
 		void bind() {
-			m_invokeable.reset();
-			m_instance = nullptr;
-			m_memberbinding = nullptr;
-			m_function = Function;
+			unbind();
+			m_invoke = [](function*, ArgsTy... args) -> returnty {
+				return Function(std::forward<ArgsTy>(args)...);
+			};
+			m_comparable = true;
 		}
 
 		template<typename T>
-		void bind(T lambda) {
-			m_instance = nullptr;
-			m_memberbinding = nullptr;
-			m_function = nullptr;
-			if constexpr (std::is_convertible_v<T, funcsigty>) // easily converted lambda
-				m_function = lambda;
-			else  // heap allocated invokable object
-				m_invokeable.reset(new invokeable<T>(lambda));
+		void bind(T&& lambda) {
+			using object_t = std::decay_t<T>;
+			unbind();
+			if constexpr (std::is_convertible_v<object_t, funcsigty>) { // easily converted lambda
+				store_inline<funcsigty>(static_cast<funcsigty>(lambda));
+				m_comparable = true;
+			} else if constexpr (fits_inline<object_t>()) {
+				store_inline<object_t>(std::forward<T>(lambda));
+			} else { // too large, heap allocated invokable object
+				object_t* object = new object_t(std::forward<T>(lambda));
+				std::memcpy(m_storage, &object, sizeof(object));
+				m_invoke = [](function* self, ArgsTy... args) -> returnty {
+					return (*self->template heap_object<object_t>())(std::forward<ArgsTy>(args)...);
+				};
+				m_manage = [](manage_op op, function* self, const function* other) {
+					if (op == manage_op::destroy) delete self->template heap_object<object_t>();
+					else if (op == manage_op::copy) {
+						object_t* copy = new object_t(*const_cast<function*>(other)->template heap_object<object_t>());
+						std::memcpy(self->m_storage, &copy, sizeof(copy));
+					}
+					else std::memcpy(self->m_storage, other->m_storage, sizeof(object_t*));
+				};
+			}
 		}
 
 		template<auto Member, typename ClassTy = typename detail::func_sig<decltype(Member)>::class_ty>
 		void bind(ClassTy* instance) {
-			m_invokeable.reset();
-			m_instance = instance;
-			m_function = nullptr;
-			m_memberbinding = [](void* ptr, ArgsTy... args) { // binding lambda
-				return (reinterpret_cast<ClassTy*>(ptr)->*Member)(args...);
+			unbind();
+			std::memcpy(m_storage, &instance, sizeof(instance));
+			m_invoke = [](function* self, ArgsTy... args) -> returnty { // binding lambda
+				ClassTy* ptr;
+				std::memcpy(&ptr, self->m_storage, sizeof(ptr));
+				return (ptr->*Member)(std::forward<ArgsTy>(args)...);
 			};
+			m_comparable = true;
 		}
 
 		returnty operator()(ArgsTy... args) const {
-			// invoke member function
-			if (m_instance)			return m_memberbinding(m_instance, args...);
-			// invoke non-member function
-			else if (m_function)	return m_function(args...);
-			// invoke pointer to invokeable
-			else					return m_invokeable->invoke(args...);
+			return m_invoke(const_cast<function*>(this), std::forward<ArgsTy>(args)...);
 		}
 
 	private:
 
-		struct _invokable {
-			virtual returnty invoke(ArgsTy...) = 0;
-		};
+		enum class manage_op : uint8 { copy, move, destroy };
+
+		alignas(std::max_align_t) std::byte m_storage[storage_size];
+		returnty(*m_invoke)(function*, ArgsTy...);
+		// null if the storage can be copied byte for byte
+		void(*m_manage)(manage_op, function*, const function*);
+		bool m_comparable;
+
 		template<typename ObjectTy>
-		struct invokeable : _invokable {
-			ObjectTy object;
-			returnty invoke(ArgsTy... args) override {
-				object(args...);
-			}
-			invokeable(ObjectTy& object_) : object(object_) { }
-		};
+		static constexpr bool fits_inline() {
+			return sizeof(ObjectTy) <= storage_size
+				&& alignof(ObjectTy) <= alignof(std::max_align_t)
+				&& std::is_nothrow_move_constructible_v<ObjectTy>;
+		}
+
 		template<typename ObjectTy>
-		struct invokeable<ObjectTy&> : _invokable {
-			ObjectTy& object;
-			returnty invoke(ArgsTy... args) override {
-				object(args...);
-			}
-			invokeable(ObjectTy& object_) : object(object_) { }
-		};
+		ObjectTy* inline_object() {
+			return std::launder(reinterpret_cast<ObjectTy*>(m_storage));
+		}
+
 		template<typename ObjectTy>
-		struct invokeable<ObjectTy*> : _invokable {
+		ObjectTy* heap_object() {
 			ObjectTy* object;
-			returnty invoke(ArgsTy... args) override {
-				(*object)(args...);
+			std::memcpy(&object, m_storage, sizeof(object));
+			return object;
+		}
+
+		template<typename ObjectTy, typename T>
+		void store_inline(T&& object) {
+			new (m_storage) ObjectTy(std::forward<T>(object));
+			m_invoke = [](function* self, ArgsTy... args) -> returnty {
+				return (*self->template inline_object<ObjectTy>())(std::forward<ArgsTy>(args)...);
+			};
+			if constexpr (!std::is_trivially_copyable_v<ObjectTy>) {
+				m_manage = [](manage_op op, function* self, const function* other) {
+					function* source = const_cast<function*>(other);
+					if (op == manage_op::destroy) self->template inline_object<ObjectTy>()->~ObjectTy();
+					else if (op == manage_op::copy) new (self->m_storage) ObjectTy(*source->template inline_object<ObjectTy>());
+					else {
+						new (self->m_storage) ObjectTy(std::move(*source->template inline_object<ObjectTy>()));
+						source->template inline_object<ObjectTy>()->~ObjectTy();
+					}
+				};
 			}
-			invokeable(ObjectTy* object_) : object(object_) { }
-		};
+		}
 
-		void* m_instance;
-		union {
-			returnty(*m_memberbinding)(void*, ArgsTy...);
-			funcsigty m_function;
-		};
-		std::shared_ptr<_invokable> m_invokeable;
+		void copy_from(const function& other) {
+			if (other.m_manage) other.m_manage(manage_op::copy, this, &other);
+			else std::memcpy(m_storage, other.m_storage, storage_size);
+			m_invoke = other.m_invoke;
+			m_manage = other.m_manage;
+			m_comparable = other.m_comparable;
+		}
+
+		void move_from(function& other) {
+			if (other.m_manage) other.m_manage(manage_op::move, this, &other);
+			else std::memcpy(m_storage, other.m_storage, storage_size);
+			m_invoke = other.m_invoke;
+			m_manage = other.m_manage;
+			m_comparable = other.m_comparable;
+			other.m_invoke = nullptr;
+			other.m_manage = nullptr;
+			other.m_comparable = false;
+		}
 	};
 
 	template<auto Function, typename function = detail::get_function_t<Function>>
 	function make_function() {
 		function f;
-		f.bind<Function>();
+		f.template bind<Function>();
 		return f;
 	}
 
 	template<auto Member, typename ClassTy, typename function = detail::get_function_t<Member>>
 	function make_function(ClassTy* instance) {
 		function f;
-		f.bind<Member>(instance);
+		f.template bind<Member>(instance);
 		return f;
 	}
 
 	template<auto Lambda, typename... ArgsHint, typename function = function<ArgsHint...>>
 	function make_function() {
 		function f;
-		f.bind<Lambda>();
+		f.template bind<Lambda>();
 		return f;
 	}
 
@@ -216,45 +301,183 @@ namespace alc {
 		return function(lambda);
 	}
 
+	// returned when subscribing to an event, used to unsubscribe without searching
+	struct event_token final {
+		uint32 slot = static_cast<uint32>(-1);
+		uint32 generation = 0;
+
+		bool is_valid() const {
+			return slot != static_cast<uint32>(-1);
+		}
+	};
+
+	// listeners are stored contiguously and removed with swap and pop
+	// so the call order is not the subscribe order once listeners are removed
+	// listeners may subscribe and unsubscribe while the event is being invoked,
+	// new listeners are called starting with the next invoke
 	template<typename _RetTy, typename... ArgsTy>
 	struct event {
 		using returnty = _RetTy;
 		using funcsigty = returnty(*)(ArgsTy...);
-		using function = function<_RetTy, ArgsTy...>;
+		using function = alc::function<_RetTy, ArgsTy...>;
 		using arguments = std::tuple<ArgsTy...>;
 
 		event() { }
 
-		event& operator+=(const function& f) {
-			for (auto& func : m_listeners) {
-				if (func == f) {
-					return *this;
-				}
+		// adds a listener and returns the token to remove it with
+		event_token subscribe(const function& f) {
+			if (!f) return event_token();
+
+			const uint32 slot = allocate_slot();
+			if (m_invoking > 0) {
+				m_slots[slot].index = pending_bit | static_cast<uint32>(m_pending.size());
+				m_pending.push_back(f);
+				m_pendingSlots.push_back(slot);
+			} else {
+				m_slots[slot].index = static_cast<uint32>(m_listeners.size());
+				m_listeners.push_back(f);
+				m_listenerSlots.push_back(slot);
 			}
-			m_listeners.push_back(f);
+			return event_token{ slot, m_slots[slot].generation };
+		}
+
+		// removes the listener that the token was returned for and resets the token
+		void unsubscribe(event_token& token) {
+			if (token.is_valid() && token.slot < m_slots.size() && m_slots[token.slot].generation == token.generation)
+				remove_slot(token.slot);
+			token = event_token();
+		}
+
+		// adds a listener, does not check for duplicates
+		event& operator+=(const function& f) {
+			subscribe(f);
 			return *this;
 		}
 
+		// removes every listener equal to f
+		// this searches every listener, prefer subscribe and unsubscribe
 		event& operator-=(const function& f) {
-			m_listeners.remove_if([f](auto& func) { return func == f; });
+			for (size_t i = m_listeners.size(); i-- > 0;) {
+				if (m_listenerSlots[i] != npos && m_listeners[i] == f) remove_slot(m_listenerSlots[i]);
+			}
+			for (size_t i = 0; i < m_pending.size(); i++) {
+				if (m_pendingSlots[i] != npos && m_pending[i] == f) remove_slot(m_pendingSlots[i]);
+			}
 			return *this;
 		}
 
+		// listeners can change the event while it is invoked, the changes are applied once invoking finishes
 		void operator()(ArgsTy... args) const {
-			for (auto& func : m_listeners) func(args...);
+			event* self = const_cast<event*>(this);
+			++self->m_invoking;
+			const size_t count = m_listeners.size();
+			for (size_t i = 0; i < count; i++) {
+				if (m_listenerSlots[i] != npos) m_listeners[i](args...);
+			}
+			if (--self->m_invoking == 0) self->flush();
 		}
 
 		template<typename T>
 		void operator()(T returncallback, ArgsTy... args) {
-			for (auto& func : m_listeners) returncallback(func(args...));
+			++m_invoking;
+			const size_t count = m_listeners.size();
+			for (size_t i = 0; i < count; i++) {
+				if (m_listenerSlots[i] != npos) returncallback(m_listeners[i](args...));
+			}
+			if (--m_invoking == 0) flush();
+		}
+
+		// returns the number of listeners
+		size_t size() const {
+			return m_listeners.size() + m_pending.size() - m_removed;
 		}
 
 		void clear() {
-			m_listeners.clear();
+			for (size_t i = 0; i < m_listenerSlots.size(); i++) {
+				if (m_listenerSlots[i] != npos) remove_slot(m_listenerSlots[i]);
+			}
+			for (size_t i = 0; i < m_pendingSlots.size(); i++) {
+				if (m_pendingSlots[i] != npos) remove_slot(m_pendingSlots[i]);
+			}
 		}
 
 	private:
-		std::list<function> m_listeners;
+		static constexpr uint32 npos = static_cast<uint32>(-1);
+		static constexpr uint32 pending_bit = 0x80000000u;
+
+		struct slot_t final {
+			uint32 index;
+			uint32 generation;
+		};
+
+		std::vector<function> m_listeners;
+		std::vector<uint32> m_listenerSlots; // npos once removed while invoking
+		std::vector<function> m_pending; // added while invoking
+		std::vector<uint32> m_pendingSlots;
+		std::vector<slot_t> m_slots;
+		std::vector<uint32> m_freeSlots;
+		size_t m_removed = 0; // removed while invoking
+		uint32 m_invoking = 0;
+
+		uint32 allocate_slot() {
+			if (m_freeSlots.size() > 0) {
+				const uint32 slot = m_freeSlots.back();
+				m_freeSlots.pop_back();
+				return slot;
+			}
+			m_slots.push_back(slot_t{ npos, 0 });
+			return static_cast<uint32>(m_slots.size() - 1);
+		}
+
+		void remove_slot(uint32 slot) {
+			const uint32 index = m_slots[slot].index;
+			m_slots[slot].index = npos;
+			++m_slots[slot].generation;
+			m_freeSlots.push_back(slot);
+
+			if (index & pending_bit) {
+				// never called, drop it when the pending listeners are flushed
+				const uint32 pendingIndex = index & ~pending_bit;
+				m_pending[pendingIndex].unbind();
+				m_pendingSlots[pendingIndex] = npos;
+				++m_removed;
+			} else if (m_invoking > 0) {
+				// the listeners are being iterated, remove it once invoking finishes
+				m_listenerSlots[index] = npos;
+				++m_removed;
+			} else {
+				remove_at(index);
+			}
+		}
+
+		// swap and pop
+		void remove_at(size_t index) {
+			const size_t last = m_listeners.size() - 1;
+			if (index != last) {
+				m_listeners[index] = std::move(m_listeners[last]);
+				m_listenerSlots[index] = m_listenerSlots[last];
+				if (m_listenerSlots[index] != npos) m_slots[m_listenerSlots[index]].index = static_cast<uint32>(index);
+			}
+			m_listeners.pop_back();
+			m_listenerSlots.pop_back();
+		}
+
+		void flush() {
+			if (m_removed > 0) {
+				for (size_t i = m_listeners.size(); i-- > 0;) {
+					if (m_listenerSlots[i] == npos) remove_at(i);
+				}
+				m_removed = 0;
+			}
+			for (size_t i = 0; i < m_pending.size(); i++) {
+				if (m_pendingSlots[i] == npos) continue;
+				m_slots[m_pendingSlots[i]].index = static_cast<uint32>(m_listeners.size());
+				m_listeners.push_back(std::move(m_pending[i]));
+				m_listenerSlots.push_back(m_pendingSlots[i]);
+			}
+			m_pending.clear();
+			m_pendingSlots.clear();
+		}
 	};
 
 }
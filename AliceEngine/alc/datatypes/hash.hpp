@@ -1,6 +1,8 @@
 #ifndef ALC_DATATYPES_HASH_HPP
 #define ALC_DATATYPES_HASH_HPP
 #include "../common.hpp"
+#include <string_view>
+#include <type_traits>
 
 namespace alc {
 
@@ -11,15 +13,69 @@ namespace alc {
 	enum class hash64_t : uint64 { };
 
 	// basic string hash function
+	// uses FNV-1a so values are the same on every platform and run and can be saved to disk
+	// can be evaluated at compile time
 	template<typename hashTy = hash32_t>
-	hashTy hash_string(const std::string& value);
+	constexpr hashTy hash_string(std::string_view value);
+
+	inline namespace literals {
+
+		// hashes a string literal at compile time
+		//     constexpr hash32_t player = "player"_h;
+		consteval hash32_t operator""_h(const char* str, size_t size);
+
+		// hashes a string literal at compile time
+		consteval hash64_t operator""_h64(const char* str, size_t size);
+
+	}
 
 
 	// implementations
 
-	template<typename hashTy = hash32_t>
-	inline hashTy hash_string(const std::string& value) {
-		return std::hash<std::string>{}(value);
+	namespace detail {
+
+		// 32 bit FNV-1a
+		constexpr uint32 fnv1a32(std::string_view str) {
+			uint32 hash = 2166136261u;
+			for (char c : str) {
+				hash ^= static_cast<uint8>(c);
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		// 64 bit FNV-1a
+		constexpr uint64 fnv1a64(std::string_view str) {
+			uint64 hash = 14695981039346656037ull;
+			for (char c : str) {
+				hash ^= static_cast<uint8>(c);
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+	}
+
+	template<typename hashTy>
+	inline constexpr hashTy hash_string(std::string_view value) {
+		static_assert(std::is_same_v<hashTy, hash32_t> || std::is_same_v<hashTy, hash64_t>,
+					  "hash_string only makes hash32_t or hash64_t");
+		if constexpr (std::is_same_v<hashTy, hash64_t>)
+			return static_cast<hash64_t>(detail::fnv1a64(value));
+		else
+			return static_cast<hash32_t>(detail::fnv1a32(value));
+	}
+
+	inline namespace literals {
+
+		consteval hash32_t operator""_h(const char* str, size_t size) {
+			return hash_string<hash32_t>(std::string_view(str, size));
+		}
+
+		consteval hash64_t operator""_h64(const char* str, size_t size) {
+			return hash_string<hash64_t>(std::string_view(str, size));
+		}
+
 	}
 
 }
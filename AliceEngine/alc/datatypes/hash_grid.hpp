@@ -0,0 +1,352 @@
+#ifndef ALC_DATATYPES_HASH_GRID_HPP
+#define ALC_DATATYPES_HASH_GRID_HPP
+#include "../common.hpp"
+#include "aabb.hpp"
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace alc {
+
+	// uniform grid of cells stored in a hash map so only occupied cells take memory
+	// items are stored in the cell of their center and the queries reach as far as the largest item,
+	// so each item is in exactly one cell and moving it within its cell costs nothing
+	// works best when items are about the size of a cell or smaller
+	// queries only read and can run on many threads at once
+	class hash_grid final {
+	public:
+
+		hash_grid(float cellSize = 8.0f);
+
+		// adds an item, ids should be small since they index an array
+		void insert(uint32 id, const aabb& bounds);
+
+		// moves an item
+		void update(uint32 id, const aabb& bounds);
+
+		// removes an item
+		void remove(uint32 id);
+
+		// returns the number of items
+		size_t size() const;
+
+		// returns the size of a cell
+		float get_cell_size() const;
+
+		// calls fn(id) for every item whose bounds overlap the box
+		template<typename Fn> void query(const aabb& box, Fn&& fn) const;
+
+		// calls fn(id) for every item whose bounds the ray enters, roughly from nearest to farthest
+		// fn returns the new max distance so the search can stop early
+		// the max distance can be infinite, the ray only walks through the range of cells that were occupied
+		template<typename Fn> void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Fn&& fn) const;
+
+		// calls fn(id) for items in order of their cell's distance to the point
+		// fn returns the squared radius that is still being searched, items outside of it are skipped
+		template<typename Fn> void nearest(const glm::vec3& point, Fn&& fn) const;
+
+	private:
+		struct entry final {
+			uint64 cell;
+			uint32 slot; // index in the cell
+			bool used;
+		};
+
+		std::unordered_map<uint64, std::vector<uint32>> m_cells;
+		std::vector<entry> m_entries; // indexed by id
+		std::vector<aabb> m_bounds; // indexed by id
+		float m_cellSize;
+		float m_inverseCellSize;
+		float m_maxExtent; // largest half size of any item in the grid
+		size_t m_maxExtentCount; // items with the largest half size, the rest are searched again once none are left
+		int32 m_cellMin[3]; // range of cells that were occupied since the grid was last empty
+		int32 m_cellMax[3];
+		size_t m_size;
+
+		int32 coordinate(float value) const;
+		static uint64 key(int32 x, int32 y, int32 z);
+		static void unpack(uint64 key_, int32& x, int32& y, int32& z);
+		uint64 key_of(const aabb& bounds) const;
+		static float extent_of(const aabb& bounds);
+		void add_extent(float extent);
+		void remove_extent(float extent);
+		void add_to_cell(uint32 id, uint64 cell);
+		void remove_from_cell(uint32 id);
+		template<typename Fn> void visit_cell(uint64 cell, Fn& fn) const;
+	};
+
+
+	// implementations
+
+	inline hash_grid::hash_grid(float cellSize)
+		: m_cellSize(cellSize), m_inverseCellSize(1.0f / cellSize), m_maxExtent(0.0f), m_maxExtentCount(0)
+		, m_cellMin{ std::numeric_limits<int32>::max(), std::numeric_limits<int32>::max(), std::numeric_limits<int32>::max() }
+		, m_cellMax{ std::numeric_limits<int32>::min(), std::numeric_limits<int32>::min(), std::numeric_limits<int32>::min() }
+		, m_size(0) { }
+
+	inline void hash_grid::insert(uint32 id, const aabb& bounds) {
+		if (id >= m_entries.size()) {
+			m_entries.resize(id + 1, entry{ 0, 0, false });
+			m_bounds.resize(id + 1);
+		}
+		if (m_entries[id].used) {
+			update(id, bounds);
+			return;
+		}
+		m_entries[id].used = true;
+		m_bounds[id] = bounds;
+		add_extent(extent_of(bounds));
+		add_to_cell(id, key_of(bounds));
+		++m_size;
+	}
+
+	inline void hash_grid::update(uint32 id, const aabb& bounds) {
+		const float extent = extent_of(m_bounds[id]);
+		m_bounds[id] = bounds;
+		add_extent(extent_of(bounds));
+		remove_extent(extent);
+
+		// only touch the cells when it moves into another one
+		const uint64 cell = key_of(bounds);
+		if (cell == m_entries[id].cell) return;
+		remove_from_cell(id);
+		add_to_cell(id, cell);
+	}
+
+	inline void hash_grid::remove(uint32 id) {
+		if (id >= m_entries.size() || !m_entries[id].used) return;
+		remove_from_cell(id);
+		m_entries[id].used = false;
+		--m_size;
+		remove_extent(extent_of(m_bounds[id]));
+
+		if (m_size == 0) {
+			for (int i = 0; i < 3; i++) {
+				m_cellMin[i] = std::numeric_limits<int32>::max();
+				m_cellMax[i] = std::numeric_limits<int32>::min();
+			}
+		}
+	}
+
+	inline size_t hash_grid::size() const {
+		return m_size;
+	}
+
+	inline float hash_grid::get_cell_size() const {
+		return m_cellSize;
+	}
+
+	template<typename Fn>
+	inline void hash_grid::query(const aabb& box, Fn&& fn) const {
+		auto visit = [this, &box, &fn](uint32 id) {
+			if (m_bounds[id].overlaps(box)) fn(id);
+		};
+
+		// items can reach out of their cell by up to the largest extent
+		const aabb reach = box.expanded(m_maxExtent);
+		const int32 x0 = coordinate(reach.min.x), y0 = coordinate(reach.min.y), z0 = coordinate(reach.min.z);
+		const int32 x1 = coordinate(reach.max.x), y1 = coordinate(reach.max.y), z1 = coordinate(reach.max.z);
+
+		// looking at every occupied cell is cheaper than looking up a huge range
+		const double range = double(x1 - x0 + 1) * double(y1 - y0 + 1) * double(z1 - z0 + 1);
+		if (range > static_cast<double>(m_cells.size())) {
+			for (auto& [cell, ids] : m_cells) {
+				for (uint32 id : ids) visit(id);
+			}
+			return;
+		}
+
+		for (int32 x = x0; x <= x1; x++)
+			for (int32 y = y0; y <= y1; y++)
+				for (int32 z = z0; z <= z1; z++)
+					visit_cell(key(x, y, z), visit);
+	}
+
+	template<typename Fn>
+	inline void hash_grid::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Fn&& fn) const {
+		if (m_size == 0) return;
+		const float inf = std::numeric_limits<float>::infinity();
+		glm::vec3 inverse;
+		for (int i = 0; i < 3; i++) inverse[i] = direction[i] != 0.0f ? 1.0f / direction[i] : inf;
+
+		std::unordered_set<uint64> visited;
+		auto visit = [&](uint32 id) {
+			float distance;
+			if (m_bounds[id].raycast(origin, inverse, maxDistance, &distance)) maxDistance = std::min(maxDistance, fn(id));
+		};
+
+		// walk the cells along the ray, each one also covers its neighbours that items can reach in from
+		const int32 reach = static_cast<int32>(std::ceil(m_maxExtent * m_inverseCellSize));
+
+		// only walk the part of the ray inside the occupied cells and their reach
+		const float padding = (reach + 1) * m_cellSize;
+		float t = 0.0f;
+		float end = maxDistance + padding;
+		for (int i = 0; i < 3; i++) {
+			const float low = static_cast<float>(m_cellMin[i] - reach) * m_cellSize;
+			const float high = static_cast<float>(m_cellMax[i] + reach + 1) * m_cellSize;
+			if (direction[i] == 0.0f) {
+				if (origin[i] < low || origin[i] > high) return;
+				continue;
+			}
+			float t0 = (low - origin[i]) * inverse[i];
+			float t1 = (high - origin[i]) * inverse[i];
+			if (t0 > t1) std::swap(t0, t1);
+			t = std::max(t, t0);
+			end = std::min(end, t1);
+		}
+		if (t > end) return;
+
+		const glm::vec3 start = origin + direction * t;
+		int32 cell[3], step[3];
+		float next[3], delta[3];
+		for (int i = 0; i < 3; i++) {
+			cell[i] = coordinate(start[i]);
+			step[i] = direction[i] > 0.0f ? 1 : (direction[i] < 0.0f ? -1 : 0);
+			const float boundary = (cell[i] + (step[i] > 0 ? 1 : 0)) * m_cellSize;
+			next[i] = step[i] != 0 ? t + (boundary - start[i]) * inverse[i] : inf;
+			delta[i] = step[i] != 0 ? m_cellSize * std::abs(inverse[i]) : inf;
+		}
+
+		while (t <= end && t <= maxDistance + padding) {
+			for (int32 x = -reach; x <= reach; x++)
+				for (int32 y = -reach; y <= reach; y++)
+					for (int32 z = -reach; z <= reach; z++) {
+						const uint64 k = key(cell[0] + x, cell[1] + y, cell[2] + z);
+						if (reach == 0 || visited.insert(k).second) visit_cell(k, visit);
+					}
+
+			// step into the next cell along the axis that is crossed first
+			int axis = 0;
+			if (next[1] < next[axis]) axis = 1;
+			if (next[2] < next[axis]) axis = 2;
+			if (next[axis] == inf) break;
+			t = next[axis];
+			next[axis] += delta[axis];
+			cell[axis] += step[axis];
+		}
+	}
+
+	template<typename Fn>
+	inline void hash_grid::nearest(const glm::vec3& point, Fn&& fn) const {
+		if (m_size == 0) return;
+		float radius2 = std::numeric_limits<float>::infinity();
+		size_t visited = 0;
+		auto visit = [&](uint32 id) {
+			++visited;
+			if (m_bounds[id].distance2(point) <= radius2) radius2 = fn(id);
+		};
+
+		const int32 cx = coordinate(point.x), cy = coordinate(point.y), cz = coordinate(point.z);
+		for (int32 ring = 0; visited < m_size; ring++) {
+			// everything in this ring is at least this far away
+			const float closest = std::max(0.0f, (ring - 1) * m_cellSize - m_maxExtent);
+			if (closest * closest > radius2) return;
+
+			// far away rings have more cells than the whole grid
+			const double side = 2.0 * ring + 1.0;
+			if (side * side * 6.0 > static_cast<double>(m_cells.size())) {
+				// skipping the rings that were already visited
+				for (auto& [cell, ids] : m_cells) {
+					int32 x, y, z;
+					unpack(cell, x, y, z);
+					if (std::max(std::abs(x - cx), std::max(std::abs(y - cy), std::abs(z - cz))) < ring) continue;
+					for (uint32 id : ids) visit(id);
+				}
+				return;
+			}
+
+			// only the shell of the cube
+			for (int32 x = -ring; x <= ring; x++)
+				for (int32 y = -ring; y <= ring; y++)
+					for (int32 z = -ring; z <= ring; z++) {
+						if (std::max(std::abs(x), std::max(std::abs(y), std::abs(z))) != ring) continue;
+						visit_cell(key(cx + x, cy + y, cz + z), visit);
+					}
+		}
+	}
+
+	inline int32 hash_grid::coordinate(float value) const {
+		return static_cast<int32>(std::floor(value * m_inverseCellSize));
+	}
+
+	inline uint64 hash_grid::key(int32 x, int32 y, int32 z) {
+		// 21 bits per axis
+		constexpr uint64 mask = (uint64(1) << 21) - 1;
+		return ((uint64(x) & mask) << 42) | ((uint64(y) & mask) << 21) | (uint64(z) & mask);
+	}
+
+	inline void hash_grid::unpack(uint64 key_, int32& x, int32& y, int32& z) {
+		// sign extend each axis back from 21 bits
+		auto axis = [](uint64 bits) { return static_cast<int32>(static_cast<int64>(bits << 43) >> 43); };
+		x = axis(key_ >> 42);
+		y = axis(key_ >> 21);
+		z = axis(key_);
+	}
+
+	inline uint64 hash_grid::key_of(const aabb& bounds) const {
+		const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+		return key(coordinate(center.x), coordinate(center.y), coordinate(center.z));
+	}
+
+	inline float hash_grid::extent_of(const aabb& bounds) {
+		const glm::vec3 half = (bounds.max - bounds.min) * 0.5f;
+		return std::max(half.x, std::max(half.y, half.z));
+	}
+
+	inline void hash_grid::add_extent(float extent) {
+		if (extent > m_maxExtent) {
+			m_maxExtent = extent;
+			m_maxExtentCount = 1;
+		} else if (extent == m_maxExtent) {
+			++m_maxExtentCount;
+		}
+	}
+
+	inline void hash_grid::remove_extent(float extent) {
+		if (extent != m_maxExtent || --m_maxExtentCount > 0) return;
+
+		// the largest item left, queries reach less far after it
+		m_maxExtent = 0.0f;
+		for (uint32 id = 0; id < m_entries.size(); id++) {
+			if (m_entries[id].used) add_extent(extent_of(m_bounds[id]));
+		}
+	}
+
+	inline void hash_grid::add_to_cell(uint32 id, uint64 cell) {
+		int32 coordinates[3];
+		unpack(cell, coordinates[0], coordinates[1], coordinates[2]);
+		for (int i = 0; i < 3; i++) {
+			m_cellMin[i] = std::min(m_cellMin[i], coordinates[i]);
+			m_cellMax[i] = std::max(m_cellMax[i], coordinates[i]);
+		}
+
+		std::vector<uint32>& ids = m_cells[cell];
+		m_entries[id].cell = cell;
+		m_entries[id].slot = static_cast<uint32>(ids.size());
+		ids.push_back(id);
+	}
+
+	inline void hash_grid::remove_from_cell(uint32 id) {
+		auto it = m_cells.find(m_entries[id].cell);
+		std::vector<uint32>& ids = it->second;
+
+		// swap and pop, empty cells are removed so queries dont walk over them
+		const uint32 slot = m_entries[id].slot;
+		ids[slot] = ids.back();
+		m_entries[ids[slot]].slot = slot;
+		ids.pop_back();
+		if (ids.size() == 0) m_cells.erase(it);
+	}
+
+	template<typename Fn>
+	inline void hash_grid::visit_cell(uint64 cell, Fn& fn) const {
+		auto it = m_cells.find(cell);
+		if (it == m_cells.end()) return;
+		for (uint32 id : it->second) fn(id);
+	}
+
+}
+
+#endif // !ALC_DATATYPES_HASH_GRID_HPP
\ No newline at end of file
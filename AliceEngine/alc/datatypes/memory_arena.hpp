@@ -0,0 +1,151 @@
+#ifndef ALC_DATATYPES_MEMORY_ARENA_HPP
+#define ALC_DATATYPES_MEMORY_ARENA_HPP
+#include "../common.hpp"
+#include <algorithm>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+
+namespace alc {
+
+	// a linear memory_resource, allocations are bumped out of large blocks and are only freed all at once
+	// deallocate does nothing, release or destroying the arena frees every block
+	// objects in the arena still need to be destroyed if their destructors do anything
+	// each scene owns an arena that is current on the thread while the scene is loaded, updated or drawn:
+	//     std::pmr::vector<glm::vec3> points(memory_arena::get_current());
+	class memory_arena final : public std::pmr::memory_resource {
+		ALC_NO_COPY(memory_arena);
+		ALC_NO_MOVE(memory_arena);
+	public:
+
+		// the number of bytes a block aims for
+		static constexpr size_t block_bytes = 256 * 1024;
+
+		memory_arena(size_t blockSize = block_bytes);
+		~memory_arena();
+
+		// frees every block at once
+		void release();
+
+		// returns the number of bytes handed out since the last release
+		size_t get_used() const;
+
+		// returns the number of bytes held in blocks
+		size_t get_reserved() const;
+
+		// returns the number of blocks
+		size_t get_block_count() const;
+
+		// returns the arena that is current on this thread, or null if there is none
+		static memory_arena* get_current();
+
+	private:
+		struct block final {
+			std::byte* data;
+			size_t size;
+			size_t align;
+		};
+
+		mutable std::mutex m_lock;
+		std::vector<block> m_blocks;
+		std::byte* m_cursor;
+		std::byte* m_end;
+		size_t m_used;
+		size_t m_reserved;
+		size_t m_blockSize;
+
+		static inline thread_local memory_arena* s_current = nullptr;
+
+		void* do_allocate(size_t bytes, size_t align) override;
+		void do_deallocate(void* ptr, size_t bytes, size_t align) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	public:
+		static void __set_current(memory_arena* arena);
+	};
+
+
+	// implementations
+
+	inline memory_arena::memory_arena(size_t blockSize)
+		: m_cursor(nullptr), m_end(nullptr), m_used(0), m_reserved(0), m_blockSize(blockSize) { }
+
+	inline memory_arena::~memory_arena() {
+		release();
+	}
+
+	inline void memory_arena::release() {
+		std::lock_guard<std::mutex> _(m_lock);
+		for (const block& b : m_blocks) {
+			::operator delete(b.data, b.size, std::align_val_t(b.align));
+		}
+		m_blocks.clear();
+		m_cursor = m_end = nullptr;
+		m_used = 0;
+		m_reserved = 0;
+	}
+
+	inline size_t memory_arena::get_used() const {
+		std::lock_guard<std::mutex> _(m_lock);
+		return m_used;
+	}
+
+	inline size_t memory_arena::get_reserved() const {
+		std::lock_guard<std::mutex> _(m_lock);
+		return m_reserved;
+	}
+
+	inline size_t memory_arena::get_block_count() const {
+		std::lock_guard<std::mutex> _(m_lock);
+		return m_blocks.size();
+	}
+
+	inline memory_arena* memory_arena::get_current() {
+		return s_current;
+	}
+
+	inline void memory_arena::__set_current(memory_arena* arena) {
+		s_current = arena;
+	}
+
+	inline void* memory_arena::do_allocate(size_t bytes, size_t align) {
+		std::lock_guard<std::mutex> _(m_lock);
+
+		// bump within the current block
+		const size_t padding = m_cursor ? (align - reinterpret_cast<uintptr_t>(m_cursor) % align) % align : 0;
+		if (m_cursor == nullptr || static_cast<size_t>(m_end - m_cursor) < padding + bytes) {
+			// oversized allocations get a block of their own so the current block is not wasted
+			const size_t blockAlign = std::max(align, alignof(std::max_align_t));
+			if (bytes > m_blockSize / 4) {
+				std::byte* data = static_cast<std::byte*>(::operator new(bytes, std::align_val_t(blockAlign)));
+				m_blocks.push_back(block{ data, bytes, blockAlign });
+				m_reserved += bytes;
+				m_used += bytes;
+				return data;
+			}
+			std::byte* data = static_cast<std::byte*>(::operator new(m_blockSize, std::align_val_t(blockAlign)));
+			m_blocks.push_back(block{ data, m_blockSize, blockAlign });
+			m_reserved += m_blockSize;
+			m_cursor = data;
+			m_end = data + m_blockSize;
+			void* ptr = m_cursor;
+			m_cursor += bytes;
+			m_used += bytes;
+			return ptr;
+		}
+
+		void* ptr = m_cursor + padding;
+		m_cursor += padding + bytes;
+		m_used += bytes;
+		return ptr;
+	}
+
+	inline void memory_arena::do_deallocate(void*, size_t, size_t) { }
+
+	inline bool memory_arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+		return this == &other;
+	}
+
+}
+
+#endif // !ALC_DATATYPES_MEMORY_ARENA_HPP
\ No newline at end of file
@@ -0,0 +1,172 @@
+#ifndef ALC_DATATYPES_POOL_ALLOCATOR_HPP
+#define ALC_DATATYPES_POOL_ALLOCATOR_HPP
+#include "../common.hpp"
+#include "../jobs/job_system.hpp"
+#include <algorithm>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+
+namespace alc {
+
+	// allocates fixed size slots out of large pages so objects of the same size end up next to each other
+	// freed slots are recycled and pages are only released when the pool is destroyed
+	// every job_system worker keeps its own free list and trades slots with the shared list in batches,
+	// threads that are not workers use the shared list directly
+	// pages come from the memory_resource if one is given, otherwise from the heap
+	class pool_allocator final {
+		ALC_NO_COPY(pool_allocator);
+		ALC_NO_MOVE(pool_allocator);
+	public:
+
+		// the number of bytes a page aims for
+		static constexpr size_t page_bytes = 64 * 1024;
+
+		pool_allocator(size_t size, size_t align, std::pmr::memory_resource* resource = nullptr);
+		~pool_allocator();
+
+		// returns uninitialized memory for one object
+		void* allocate();
+
+		// gives the memory back to the pool, ptr must have come from this pool
+		void deallocate(void* ptr);
+
+		// returns the size of a slot
+		size_t get_slot_size() const;
+
+		// returns the number of allocated pages
+		size_t get_page_count() const;
+
+	private:
+		struct free_node final {
+			free_node* next;
+		};
+
+		// owned by a single worker so it is never locked
+		struct alignas(64) worker_cache final {
+			free_node* head = nullptr;
+			uint32 count = 0;
+		};
+
+		static constexpr uint32 cache_count = 64;
+		static constexpr uint32 batch_size = 32;
+
+		size_t m_slotSize;
+		size_t m_align;
+		size_t m_slotsPerPage;
+		std::pmr::memory_resource* m_resource;
+		worker_cache m_caches[cache_count];
+
+		std::mutex m_lock;
+		free_node* m_free;
+		std::vector<std::byte*> m_pages;
+
+		// must hold m_lock
+		free_node* pop_shared();
+		void add_page();
+	};
+
+
+	// implementations
+
+	inline pool_allocator::pool_allocator(size_t size, size_t align, std::pmr::memory_resource* resource)
+		: m_slotSize(0), m_align(std::max(align, alignof(free_node))), m_slotsPerPage(0), m_resource(resource), m_free(nullptr) {
+		// every slot must be able to hold a free_node and stay aligned
+		m_slotSize = std::max(size, sizeof(free_node));
+		m_slotSize = (m_slotSize + m_align - 1) & ~(m_align - 1);
+		m_slotsPerPage = std::max<size_t>(page_bytes / m_slotSize, 16);
+	}
+
+	inline pool_allocator::~pool_allocator() {
+		for (std::byte* page : m_pages) {
+			if (m_resource) m_resource->deallocate(page, m_slotSize * m_slotsPerPage, m_align);
+			else ::operator delete(page, std::align_val_t(m_align));
+		}
+	}
+
+	inline void* pool_allocator::allocate() {
+		const size_t worker = job_system::get_worker_index();
+		if (worker >= cache_count) {
+			std::lock_guard<std::mutex> _(m_lock);
+			return pop_shared();
+		}
+
+		// refill from the shared list
+		worker_cache& cache = m_caches[worker];
+		if (cache.head == nullptr) {
+			std::lock_guard<std::mutex> _(m_lock);
+			free_node* last = cache.head = pop_shared();
+			for (uint32 i = 1; i < batch_size; i++) {
+				last = last->next = pop_shared();
+			}
+			last->next = nullptr;
+			cache.count = batch_size;
+		}
+
+		free_node* node = cache.head;
+		cache.head = node->next;
+		--cache.count;
+		return node;
+	}
+
+	inline void pool_allocator::deallocate(void* ptr) {
+		if (ptr == nullptr) return;
+		free_node* node = static_cast<free_node*>(ptr);
+
+		const size_t worker = job_system::get_worker_index();
+		if (worker >= cache_count) {
+			std::lock_guard<std::mutex> _(m_lock);
+			node->next = m_free;
+			m_free = node;
+			return;
+		}
+
+		worker_cache& cache = m_caches[worker];
+		node->next = cache.head;
+		cache.head = node;
+
+		// give a batch back so other workers can use it
+		if (++cache.count > batch_size * 2) {
+			std::lock_guard<std::mutex> _(m_lock);
+			for (uint32 i = 0; i < batch_size; i++) {
+				free_node* top = cache.head;
+				cache.head = top->next;
+				top->next = m_free;
+				m_free = top;
+			}
+			cache.count -= batch_size;
+		}
+	}
+
+	inline size_t pool_allocator::get_slot_size() const {
+		return m_slotSize;
+	}
+
+	inline size_t pool_allocator::get_page_count() const {
+		return m_pages.size();
+	}
+
+	inline pool_allocator::free_node* pool_allocator::pop_shared() {
+		if (m_free == nullptr) add_page();
+		free_node* node = m_free;
+		m_free = node->next;
+		return node;
+	}
+
+	inline void pool_allocator::add_page() {
+		const size_t bytes = m_slotSize * m_slotsPerPage;
+		std::byte* page = static_cast<std::byte*>(m_resource ? m_resource->allocate(bytes, m_align)
+			: ::operator new(bytes, std::align_val_t(m_align)));
+		m_pages.push_back(page);
+
+		// link backwards so the slots are handed out in address order
+		for (size_t i = m_slotsPerPage; i > 0; i--) {
+			free_node* node = reinterpret_cast<free_node*>(page + (i - 1) * m_slotSize);
+			node->next = m_free;
+			m_free = node;
+		}
+	}
+
+}
+
+#endif // !ALC_DATATYPES_POOL_ALLOCATOR_HPP
\ No newline at end of file
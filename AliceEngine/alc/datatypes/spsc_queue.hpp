@@ -0,0 +1,179 @@
+#ifndef ALC_DATATYPES_SPSC_QUEUE_HPP
+#define ALC_DATATYPES_SPSC_QUEUE_HPP
+#include "../common.hpp"
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+namespace alc {
+
+	// unbounded lock free queue with a single producer thread and a single consumer thread
+	// items are stored in blocks of BlockSize, the consumer hands one finished block back
+	// to the producer so a steady stream of items does not allocate
+	template<typename Ty, size_t BlockSize = 256>
+	class spsc_queue final {
+		ALC_NO_COPY(spsc_queue);
+		ALC_NO_MOVE(spsc_queue);
+	public:
+
+		spsc_queue();
+		~spsc_queue();
+
+		// adds an item to the back of the queue
+		// must only be called by the producer
+		template<typename... Args> void emplace(Args&&... args);
+
+		// adds an item to the back of the queue
+		// must only be called by the producer
+		void push(const Ty& item);
+
+		// adds an item to the back of the queue
+		// must only be called by the producer
+		void push(Ty&& item);
+
+		// moves the front item into out and removes it
+		// returns false if the queue is empty
+		// must only be called by the consumer
+		bool pop(Ty& out);
+
+		// calls fn with every item that is in the queue and removes them
+		// returns the number of items
+		// must only be called by the consumer
+		template<typename Fn> size_t consume(Fn&& fn);
+
+		// returns true if there is nothing to pop
+		// must only be called by the consumer
+		bool empty() const;
+
+	private:
+		struct block final {
+			alignas(Ty) std::byte items[sizeof(Ty) * BlockSize];
+			std::atomic<size_t> written = 0;
+			std::atomic<block*> next = nullptr;
+
+			Ty* at(size_t index) {
+				return std::launder(reinterpret_cast<Ty*>(items + sizeof(Ty) * index));
+			}
+		};
+
+		// consumer
+		alignas(64) block* m_head;
+		size_t m_headIndex;
+
+		// producer
+		alignas(64) block* m_tail;
+		size_t m_tailCount;
+
+		// a finished block waiting to be reused by the producer
+		alignas(64) std::atomic<block*> m_spare;
+
+		block* next_block();
+		Ty* front();
+	};
+
+
+	// implementations
+
+	template<typename Ty, size_t BlockSize>
+	inline spsc_queue<Ty, BlockSize>::spsc_queue()
+		: m_head(new block()), m_headIndex(0), m_tail(nullptr), m_tailCount(0), m_spare(nullptr) {
+		m_tail = m_head;
+	}
+
+	template<typename Ty, size_t BlockSize>
+	inline spsc_queue<Ty, BlockSize>::~spsc_queue() {
+		// destroy the items that were never popped
+		block* b = m_head;
+		size_t index = m_headIndex;
+		while (b) {
+			const size_t written = b->written.load(std::memory_order_acquire);
+			for (; index < written; index++) b->at(index)->~Ty();
+			block* next = b->next.load(std::memory_order_acquire);
+			delete b;
+			b = next;
+			index = 0;
+		}
+		delete m_spare.load(std::memory_order_acquire);
+	}
+
+	template<typename Ty, size_t BlockSize>
+	template<typename... Args>
+	inline void spsc_queue<Ty, BlockSize>::emplace(Args&&... args) {
+		if (m_tailCount == BlockSize) {
+			block* b = next_block();
+			m_tail->next.store(b, std::memory_order_release);
+			m_tail = b;
+			m_tailCount = 0;
+		}
+		new (m_tail->items + sizeof(Ty) * m_tailCount) Ty(std::forward<Args>(args)...);
+		m_tail->written.store(++m_tailCount, std::memory_order_release);
+	}
+
+	template<typename Ty, size_t BlockSize>
+	inline void spsc_queue<Ty, BlockSize>::push(const Ty& item) {
+		emplace(item);
+	}
+
+	template<typename Ty, size_t BlockSize>
+	inline void spsc_queue<Ty, BlockSize>::push(Ty&& item) {
+		emplace(std::move(item));
+	}
+
+	template<typename Ty, size_t BlockSize>
+	inline bool spsc_queue<Ty, BlockSize>::pop(Ty& out) {
+		Ty* item = front();
+		if (item == nullptr) return false;
+		out = std::move(*item);
+		item->~Ty();
+		++m_headIndex;
+		return true;
+	}
+
+	template<typename Ty, size_t BlockSize>
+	template<typename Fn>
+	inline size_t spsc_queue<Ty, BlockSize>::consume(Fn&& fn) {
+		size_t count = 0;
+		while (Ty* item = front()) {
+			fn(std::move(*item));
+			item->~Ty();
+			++m_headIndex;
+			++count;
+		}
+		return count;
+	}
+
+	template<typename Ty, size_t BlockSize>
+	inline bool spsc_queue<Ty, BlockSize>::empty() const {
+		if (m_headIndex < BlockSize) return m_headIndex >= m_head->written.load(std::memory_order_acquire);
+		block* next = m_head->next.load(std::memory_order_acquire);
+		return next == nullptr || next->written.load(std::memory_order_acquire) == 0;
+	}
+
+	template<typename Ty, size_t BlockSize>
+	inline typename spsc_queue<Ty, BlockSize>::block* spsc_queue<Ty, BlockSize>::next_block() {
+		if (block* spare = m_spare.exchange(nullptr, std::memory_order_acq_rel)) return spare;
+		return new block();
+	}
+
+	template<typename Ty, size_t BlockSize>
+	inline Ty* spsc_queue<Ty, BlockSize>::front() {
+		if (m_headIndex == BlockSize) {
+			block* next = m_head->next.load(std::memory_order_acquire);
+			if (next == nullptr) return nullptr;
+
+			// the producer has moved on, give the block back to it
+			block* finished = m_head;
+			m_head = next;
+			m_headIndex = 0;
+			finished->written.store(0, std::memory_order_relaxed);
+			finished->next.store(nullptr, std::memory_order_relaxed);
+			delete m_spare.exchange(finished, std::memory_order_acq_rel);
+		}
+
+		if (m_headIndex >= m_head->written.load(std::memory_order_acquire)) return nullptr;
+		return m_head->at(m_headIndex);
+	}
+
+}
+
+#endif // !ALC_DATATYPES_SPSC_QUEUE_HPP
\ No newline at end of file
@@ -0,0 +1,262 @@
+#ifndef ALC_DATATYPES_TIMER_WHEEL_HPP
+#define ALC_DATATYPES_TIMER_WHEEL_HPP
+#include "../common.hpp"
+#include "function.hpp"
+
+namespace alc {
+
+	// refers to a scheduled timer, stays safe to use after the timer fired or was cancelled
+	struct timer_handle final {
+		uint32 index = 0;
+		uint32 generation = 0; // 0 is never used by a live timer
+
+		// returns true if this never referred to a timer
+		bool is_null() const;
+
+		bool operator==(const timer_handle&) const = default;
+	};
+
+	// hierarchical timing wheel
+	// callbacks are scheduled at an integer tick, scheduling and cancelling are constant time
+	// the first level has a slot for each of the next 256 ticks, every level above covers 256 times as much
+	// and moves its timers down a level when the level below wraps around
+	// ticks further away than the top level covers wait in the top level until they come into range
+	class timer_wheel final {
+		ALC_NO_COPY(timer_wheel);
+		ALC_NO_MOVE(timer_wheel);
+	public:
+
+		static constexpr uint32 slot_bits = 8;
+		static constexpr uint32 slot_count = 1u << slot_bits;
+		static constexpr uint32 level_count = 4;
+
+		timer_wheel(uint64 tick = 0);
+
+		// schedules fn to be expired at the tick, ticks that already passed expire on the next advance
+		timer_handle schedule(uint64 tick, const function<void>& fn);
+
+		// removes the timer without expiring it
+		// returns false if it already expired or was cancelled
+		bool cancel(timer_handle handle);
+
+		// stops the timer from counting down until it is resumed
+		// returns false if it is not waiting or already paused
+		bool pause(timer_handle handle);
+
+		// lets a paused timer count down the ticks it had left
+		// returns false if it is not paused
+		bool resume(timer_handle handle);
+
+		// returns true if the timer is still waiting, paused timers are waiting
+		bool is_pending(timer_handle handle) const;
+
+		// returns the current tick
+		uint64 get_tick() const;
+
+		// returns the number of waiting timers, including paused ones
+		size_t size() const;
+
+		// moves forward to the tick and adds the callback of every timer that expired to the container
+		// callbacks are added in tick order and returns how many were added
+		template<typename Container> size_t advance(uint64 tick, Container* expired);
+
+		// removes every timer
+		void clear();
+
+	private:
+		static constexpr uint32 npos = static_cast<uint32>(-1);
+		static constexpr uint32 paused = npos - 1; // slot of paused nodes, they are not linked into the wheel
+		static constexpr uint32 slot_mask = slot_count - 1;
+
+		// timers are linked into their slot through their index
+		struct node final {
+			function<void> fn;
+			uint64 tick = 0; // the ticks left while paused
+			uint32 prev = npos;
+			uint32 next = npos;
+			uint32 slot = npos; // npos when the node is free
+			uint32 generation = 1;
+		};
+		std::vector<node> m_nodes;
+		std::vector<uint32> m_heads; // level * slot_count + slot, the first node in the slot
+		std::vector<uint32> m_tails; // the last node in the slot, new timers go at the end
+		uint32 m_free;
+		uint64 m_tick;
+		size_t m_size;
+		size_t m_paused;
+
+		void link(uint32 index);
+		void unlink(uint32 index);
+		void release(uint32 index);
+		void cascade(uint32 level);
+	};
+
+
+	// implementations
+
+	inline bool timer_handle::is_null() const {
+		return generation == 0;
+	}
+
+	inline timer_wheel::timer_wheel(uint64 tick)
+		: m_heads(level_count * slot_count, npos), m_tails(level_count * slot_count, npos), m_free(npos), m_tick(tick), m_size(0), m_paused(0) { }
+
+	inline timer_handle timer_wheel::schedule(uint64 tick, const function<void>& fn) {
+		uint32 index = m_free;
+		if (index != npos) {
+			m_free = m_nodes[index].next;
+		} else {
+			index = static_cast<uint32>(m_nodes.size());
+			m_nodes.emplace_back();
+		}
+		node& n = m_nodes[index];
+		n.fn = fn;
+		n.tick = tick;
+		link(index);
+		++m_size;
+		return timer_handle{ index, n.generation };
+	}
+
+	inline bool timer_wheel::cancel(timer_handle handle) {
+		if (!is_pending(handle)) return false;
+		if (m_nodes[handle.index].slot == paused) --m_paused;
+		else unlink(handle.index);
+		release(handle.index);
+		return true;
+	}
+
+	inline bool timer_wheel::pause(timer_handle handle) {
+		if (!is_pending(handle) || m_nodes[handle.index].slot == paused) return false;
+		unlink(handle.index);
+		node& n = m_nodes[handle.index];
+		n.tick = n.tick > m_tick ? n.tick - m_tick : 0;
+		n.slot = paused;
+		++m_paused;
+		return true;
+	}
+
+	inline bool timer_wheel::resume(timer_handle handle) {
+		if (!is_pending(handle) || m_nodes[handle.index].slot != paused) return false;
+		node& n = m_nodes[handle.index];
+		n.tick += m_tick;
+		link(handle.index);
+		--m_paused;
+		return true;
+	}
+
+	inline bool timer_wheel::is_pending(timer_handle handle) const {
+		return handle.index < m_nodes.size()
+			&& m_nodes[handle.index].generation == handle.generation
+			&& m_nodes[handle.index].slot != npos;
+	}
+
+	inline uint64 timer_wheel::get_tick() const {
+		return m_tick;
+	}
+
+	inline size_t timer_wheel::size() const {
+		return m_size;
+	}
+
+	template<typename Container>
+	inline size_t timer_wheel::advance(uint64 tick, Container* expired) {
+		size_t count = 0;
+
+		// timers scheduled in the past sit in the current slot
+		auto expire_slot = [this, expired, &count](uint32 slot) {
+			while (m_heads[slot] != npos) {
+				const uint32 index = m_heads[slot];
+				unlink(index);
+				expired->push_back(std::move(m_nodes[index].fn));
+				release(index);
+				++count;
+			}
+		};
+		expire_slot(static_cast<uint32>(m_tick & slot_mask));
+
+		while (m_tick < tick) {
+			// nothing is counting down, skip straight to the end
+			if (m_size == m_paused) {
+				m_tick = tick;
+				break;
+			}
+			++m_tick;
+
+			// a level wrapped around, move the next slot of the level above down
+			for (uint32 level = 1; level < level_count; level++) {
+				if (((m_tick >> (slot_bits * (level - 1))) & slot_mask) != 0) break;
+				cascade(level);
+			}
+			expire_slot(static_cast<uint32>(m_tick & slot_mask));
+		}
+		return count;
+	}
+
+	inline void timer_wheel::clear() {
+		for (uint32 i = 0; i < m_nodes.size(); i++) {
+			if (m_nodes[i].slot == paused) {
+				release(i);
+			} else if (m_nodes[i].slot != npos) {
+				unlink(i);
+				release(i);
+			}
+		}
+		m_paused = 0;
+	}
+
+	inline void timer_wheel::link(uint32 index) {
+		node& n = m_nodes[index];
+
+		// pick the lowest level that reaches the tick
+		const uint64 delta = n.tick > m_tick ? n.tick - m_tick : 0;
+		uint32 level = 0;
+		while (level + 1 < level_count && delta >= (uint64(1) << (slot_bits * (level + 1)))) ++level;
+
+		// too far away for the top level, wait in its furthest slot and get placed again when it cascades
+		uint64 tick = n.tick > m_tick ? n.tick : m_tick;
+		const uint64 reach = uint64(1) << (slot_bits * level_count);
+		if (delta >= reach) tick = m_tick + reach - (uint64(1) << (slot_bits * (level_count - 1)));
+
+		const uint32 slot = level * slot_count + static_cast<uint32>((tick >> (slot_bits * level)) & slot_mask);
+		n.slot = slot;
+		n.prev = m_tails[slot];
+		n.next = npos;
+		if (n.prev != npos) m_nodes[n.prev].next = index;
+		else m_heads[slot] = index;
+		m_tails[slot] = index;
+	}
+
+	inline void timer_wheel::unlink(uint32 index) {
+		node& n = m_nodes[index];
+		if (n.prev != npos) m_nodes[n.prev].next = n.next;
+		else m_heads[n.slot] = n.next;
+		if (n.next != npos) m_nodes[n.next].prev = n.prev;
+		else m_tails[n.slot] = n.prev;
+		n.slot = npos;
+	}
+
+	inline void timer_wheel::release(uint32 index) {
+		node& n = m_nodes[index];
+		n.fn = nullptr;
+		n.slot = npos;
+		if (++n.generation == 0) n.generation = 1;
+		n.next = m_free;
+		m_free = index;
+		--m_size;
+	}
+
+	inline void timer_wheel::cascade(uint32 level) {
+		const uint32 slot = level * slot_count + static_cast<uint32>((m_tick >> (slot_bits * level)) & slot_mask);
+		uint32 index = m_heads[slot];
+		m_heads[slot] = npos;
+		m_tails[slot] = npos;
+		while (index != npos) {
+			const uint32 next = m_nodes[index].next;
+			link(index);
+			index = next;
+		}
+	}
+
+}
+
+#endif // !ALC_DATATYPES_TIMER_WHEEL_HPP
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include "archetype.hpp"
+#include "entity_factory.hpp"
+#include <algorithm>
+#include <atomic>
+
+namespace alc {
+
+	namespace {
+		inline size_t align_up(size_t value, size_t align) {
+			return (value + align - 1) & ~(align - 1);
+		}
+	}
+
+	archetype::archetype(const signature& signature_, std::pmr::memory_resource* resource)
+		: m_signature(signature_), m_chunkCapacity(0), m_chunkAlloc(0)
+		, m_chunkAlign(alignof(entity*)), m_size(0), m_resource(resource) {
+
+		// build the lookup table so columns can be found directly by typehash
+		for (size_t i = 0; i < m_signature.size(); i++) {
+			const size_t type = static_cast<size_t>(m_signature[i]->type);
+			if (type >= m_columnLookup.size()) m_columnLookup.resize(type + 1, npos);
+			m_columnLookup[type] = i;
+		}
+
+		// find how many rows fit into a chunk
+		size_t rowsize = sizeof(entity*);
+		for (auto* info : m_signature) {
+			rowsize += info->size + sizeof(uint32) * 2;
+			m_chunkAlign = std::max(m_chunkAlign, info->align);
+		}
+		m_chunkCapacity = std::max<size_t>(chunk_bytes / rowsize, 1);
+
+		// layout: [entities][column 0][column 1]...[versions 0][versions 1]...
+		size_t offset = sizeof(entity*) * m_chunkCapacity;
+		m_offsets.reserve(m_signature.size());
+		for (auto* info : m_signature) {
+			offset = align_up(offset, info->align);
+			m_offsets.push_back(offset);
+			offset += info->size * m_chunkCapacity;
+		}
+		offset = align_up(offset, alignof(uint32));
+		m_versionOffsets.reserve(m_signature.size());
+		for (size_t i = 0; i < m_signature.size(); i++) {
+			m_versionOffsets.push_back(offset);
+			offset += sizeof(uint32) * 2 * m_chunkCapacity;
+		}
+		m_chunkAlloc = align_up(offset, m_chunkAlign);
+	}
+
+	archetype::~archetype() {
+		// destroy remaining components
+		for (size_t row = 0; row < m_size; row++) {
+			for (size_t c = 0; c < m_signature.size(); c++) {
+				m_signature[c]->destroy(get(row, c));
+			}
+		}
+		// free chunks
+		for (std::byte* chunk : m_chunks) free_chunk(chunk);
+		for (std::byte* chunk : m_spareChunks) free_chunk(chunk);
+	}
+
+	const archetype::signature& archetype::get_signature() const {
+		return m_signature;
+	}
+
+	bool archetype::has(const detail::component_info* info) const {
+		return column_of(info->type) != npos;
+	}
+
+	bool archetype::has(typehash type) const {
+		return column_of(type) != npos;
+	}
+
+	size_t archetype::column_of(const detail::component_info* info) const {
+		return column_of(info->type);
+	}
+
+	size_t archetype::column_of(typehash type) const {
+		const size_t index = static_cast<size_t>(type);
+		return index < m_columnLookup.size() ? m_columnLookup[index] : npos;
+	}
+
+	size_t archetype::column_count() const {
+		return m_signature.size();
+	}
+
+	size_t archetype::size() const {
+		return m_size;
+	}
+
+	size_t archetype::chunk_count() const {
+		return m_chunks.size();
+	}
+
+	size_t archetype::chunk_capacity() const {
+		return m_chunkCapacity;
+	}
+
+	size_t archetype::chunk_size(size_t chunk) const {
+		const size_t begin = chunk * m_chunkCapacity;
+		if (begin >= m_size) return 0;
+		return std::min(m_size - begin, m_chunkCapacity);
+	}
+
+	entity** archetype::entities(size_t chunk) const {
+		return reinterpret_cast<entity**>(m_chunks[chunk]);
+	}
+
+	void* archetype::column(size_t chunk, size_t column_) const {
+		return m_chunks[chunk] + m_offsets[column_];
+	}
+
+	uint32* archetype::changed_versions(size_t chunk, size_t column_) const {
+		return reinterpret_cast<uint32*>(m_chunks[chunk] + m_versionOffsets[column_]);
+	}
+
+	uint32* archetype::added_versions(size_t chunk, size_t column_) const {
+		return changed_versions(chunk, column_) + m_chunkCapacity;
+	}
+
+	uint32 archetype::chunk_version(size_t chunk, size_t column_) const {
+		return std::atomic_ref<const uint32>(m_chunkVersions[chunk * m_signature.size() + column_]).load(std::memory_order_relaxed);
+	}
+
+	void archetype::set_changed(size_t row, size_t column_, uint32 version) {
+		const size_t chunk = row / m_chunkCapacity;
+		changed_versions(chunk, column_)[row % m_chunkCapacity] = version;
+
+		// rows in the same chunk can be changed from different threads
+		std::atomic_ref<uint32> newest(m_chunkVersions[chunk * m_signature.size() + column_]);
+		if (newest.load(std::memory_order_relaxed) < version) newest.store(version, std::memory_order_relaxed);
+	}
+
+	void archetype::set_chunk_changed(size_t chunk, size_t column_, uint32 version) {
+		std::fill_n(changed_versions(chunk, column_), chunk_size(chunk), version);
+		std::atomic_ref<uint32> newest(m_chunkVersions[chunk * m_signature.size() + column_]);
+		if (newest.load(std::memory_order_relaxed) < version) newest.store(version, std::memory_order_relaxed);
+	}
+
+	void archetype::set_added(size_t row, size_t column_, uint32 version) {
+		added_versions(row / m_chunkCapacity, column_)[row % m_chunkCapacity] = version;
+		set_changed(row, column_, version);
+	}
+
+	void* archetype::get(size_t row, size_t column_) const {
+		const size_t chunk = row / m_chunkCapacity;
+		const size_t index = row % m_chunkCapacity;
+		return m_chunks[chunk] + m_offsets[column_] + index * m_signature[column_]->size;
+	}
+
+	entity* archetype::get_entity(size_t row) const {
+		return entities(row / m_chunkCapacity)[row % m_chunkCapacity];
+	}
+
+	void archetype::reserve(size_t rows) {
+		while (m_chunks.size() * m_chunkCapacity < m_size + rows) add_chunk();
+	}
+
+	size_t archetype::emplace(entity* e) {
+		if (m_size == m_chunks.size() * m_chunkCapacity) add_chunk();
+		const size_t row = m_size++;
+		const size_t chunk = row / m_chunkCapacity;
+		const size_t index = row % m_chunkCapacity;
+		entities(chunk)[index] = e;
+		for (size_t c = 0; c < m_signature.size(); c++) {
+			changed_versions(chunk, c)[index] = 0;
+			added_versions(chunk, c)[index] = 0;
+		}
+		return row;
+	}
+
+	size_t archetype::relocate(size_t row, archetype* other) {
+		const size_t newrow = other->emplace(get_entity(row));
+
+		// both signatures are sorted so walk them together
+		size_t j = 0;
+		for (size_t i = 0; i < m_signature.size(); i++) {
+			while (j < other->m_signature.size() && detail::component_info_less(other->m_signature[j], m_signature[i])) ++j;
+			if (j < other->m_signature.size() && other->m_signature[j] == m_signature[i]) {
+				m_signature[i]->relocate(other->get(newrow, j), get(row, i));
+				other->copy_versions(newrow, j, this, row, i);
+			} else
+				m_signature[i]->destroy(get(row, i));
+		}
+
+		remove_row(row);
+		return newrow;
+	}
+
+	void archetype::erase(size_t row) {
+		for (size_t c = 0; c < m_signature.size(); c++) {
+			m_signature[c]->destroy(get(row, c));
+		}
+		remove_row(row);
+	}
+
+	void archetype::clear() {
+		// column by column so each array is walked in order
+		for (size_t c = 0; c < m_signature.size(); c++) {
+			const detail::component_info* info = m_signature[c];
+			for (size_t chunk = 0; chunk < m_chunks.size(); chunk++) {
+				std::byte* data = static_cast<std::byte*>(column(chunk, c));
+				const size_t rows = chunk_size(chunk);
+				for (size_t i = 0; i < rows; i++) info->destroy(data + i * info->size);
+			}
+		}
+		m_size = 0;
+		m_spareChunks.insert(m_spareChunks.end(), m_chunks.begin(), m_chunks.end());
+		m_chunks.clear();
+		m_chunkVersions.clear();
+	}
+
+	void archetype::remove_row(size_t row) {
+		const size_t last = m_size - 1;
+
+		// fill the hole with the last row
+		if (row != last) {
+			for (size_t c = 0; c < m_signature.size(); c++) {
+				m_signature[c]->relocate(get(row, c), get(last, c));
+				copy_versions(row, c, this, last, c);
+			}
+			entity* moved = get_entity(last);
+			entities(row / m_chunkCapacity)[row % m_chunkCapacity] = moved;
+			moved->__set_row(row);
+		}
+		--m_size;
+
+		// put the last chunk aside once it becomes empty
+		if (m_chunks.size() > 0 && m_size <= (m_chunks.size() - 1) * m_chunkCapacity) {
+			m_spareChunks.push_back(m_chunks.back());
+			m_chunks.pop_back();
+		}
+	}
+
+	void archetype::copy_versions(size_t row, size_t column_, const archetype* other, size_t otherRow, size_t otherColumn) {
+		const size_t chunk = row / m_chunkCapacity;
+		const size_t index = row % m_chunkCapacity;
+		const size_t otherChunk = otherRow / other->m_chunkCapacity;
+		const size_t otherIndex = otherRow % other->m_chunkCapacity;
+		const uint32 changed = other->changed_versions(otherChunk, otherColumn)[otherIndex];
+		changed_versions(chunk, column_)[index] = changed;
+		added_versions(chunk, column_)[index] = other->added_versions(otherChunk, otherColumn)[otherIndex];
+
+		uint32& newest = m_chunkVersions[chunk * m_signature.size() + column_];
+		newest = std::max(newest, changed);
+	}
+
+	void archetype::add_chunk() {
+		if (m_spareChunks.size() > 0) {
+			m_chunks.push_back(m_spareChunks.back());
+			m_spareChunks.pop_back();
+		} else {
+			m_chunks.push_back(static_cast<std::byte*>(m_resource ? m_resource->allocate(m_chunkAlloc, m_chunkAlign)
+				: ::operator new(m_chunkAlloc, std::align_val_t(m_chunkAlign))));
+		}
+		m_chunkVersions.resize(m_chunks.size() * m_signature.size());
+		std::fill(m_chunkVersions.end() - m_signature.size(), m_chunkVersions.end(), 0);
+	}
+
+	void archetype::free_chunk(std::byte* chunk) {
+		if (m_resource) m_resource->deallocate(chunk, m_chunkAlloc, m_chunkAlign);
+		else ::operator delete(chunk, std::align_val_t(m_chunkAlign));
+	}
+
+	archetype* archetype::__get_add_edge(const detail::component_info* info) const {
+		auto it = m_addEdges.find(info);
+		return it == m_addEdges.end() ? nullptr : it->second;
+	}
+
+	archetype* archetype::__get_remove_edge(const detail::component_info* info) const {
+		auto it = m_removeEdges.find(info);
+		return it == m_removeEdges.end() ? nullptr : it->second;
+	}
+
+	void archetype::__set_add_edge(const detail::component_info* info, archetype* arch) {
+		m_addEdges[info] = arch;
+	}
+
+	void archetype::__set_remove_edge(const detail::component_info* info, archetype* arch) {
+		m_removeEdges[info] = arch;
+	}
+
+}
@@ -0,0 +1,231 @@
+#ifndef ALC_ENTITIES_ARCHETYPE_HPP
+#define ALC_ENTITIES_ARCHETYPE_HPP
+#include "../common.hpp"
+#include "../reflection/typehash.hpp"
+#include <memory_resource>
+#include <type_traits>
+#include <unordered_map>
+#include <new>
+
+namespace alc {
+
+	struct component;
+	class entity;
+
+	namespace detail {
+
+		// type erased information about a component type
+		// used by archetypes to construct, move and destroy components in their columns
+		struct component_info final {
+			typehash type;
+			size_t size;
+			size_t align;
+
+			// move constructs src into dst and then destroys src
+			void(*relocate)(void* dst, void* src);
+
+			// copy constructs src into dst, null if the type cannot be copied
+			void(*copy)(void* dst, const void* src);
+
+			// calls the destructor
+			void(*destroy)(void* ptr);
+
+			// casts the pointer to its component base
+			component* (*to_component)(void* ptr);
+		};
+
+		// returns the component_info for the type
+		// the address of the returned value is unique for every type
+		template<typename Ty>
+		const component_info* get_component_info();
+
+		// orders component_info by typehash
+		bool component_info_less(const component_info* lhs, const component_info* rhs);
+
+	}
+
+	// stores every entity that has the exact same set of components
+	// components are stored by value in chunks, one contiguous array per component type (SoA)
+	// rows are always tightly packed, removing a row moves the last row into its place
+	// chunks that become empty are kept and reused instead of being freed
+	// chunks come from the memory_resource if one is given, otherwise from the heap
+	// every component also stores the version it was last changed in and the version it was added in,
+	// and every chunk keeps the newest change of each column so unchanged chunks can be skipped
+	class archetype final {
+		ALC_NO_COPY(archetype);
+		ALC_NO_MOVE(archetype);
+	public:
+		// component types sorted by typehash
+		using signature = std::vector<const detail::component_info*>;
+
+		// the target size of a single chunk in bytes
+		static constexpr size_t chunk_bytes = 16 * 1024;
+
+		// returned when a column does not exist
+		static constexpr size_t npos = static_cast<size_t>(-1);
+
+		// creates an archetype from a sorted signature
+		archetype(const signature& signature_, std::pmr::memory_resource* resource = nullptr);
+		~archetype();
+
+		// returns the sorted list of component types
+		const signature& get_signature() const;
+
+		// returns true if this archetype stores the component type
+		bool has(const detail::component_info* info) const;
+
+		// returns true if this archetype stores the component type
+		bool has(typehash type) const;
+
+		// returns the column index of the component type or npos
+		size_t column_of(const detail::component_info* info) const;
+
+		// returns the column index of the component type or npos
+		size_t column_of(typehash type) const;
+
+		// returns the number of columns
+		size_t column_count() const;
+
+		// returns the total number of rows
+		size_t size() const;
+
+		// returns the number of allocated chunks
+		size_t chunk_count() const;
+
+		// returns the max number of rows a chunk can hold
+		size_t chunk_capacity() const;
+
+		// returns the number of rows used in the chunk
+		size_t chunk_size(size_t chunk) const;
+
+		// returns the array of entities in the chunk
+		entity** entities(size_t chunk) const;
+
+		// returns the array of components in the chunk for the column
+		void* column(size_t chunk, size_t column) const;
+
+		// returns the array of components in the chunk for the column
+		template<typename Ty> Ty* column(size_t chunk, size_t column) const;
+
+		// returns the versions each component in the chunk was last changed in
+		uint32* changed_versions(size_t chunk, size_t column) const;
+
+		// returns the versions each component in the chunk was added in
+		uint32* added_versions(size_t chunk, size_t column) const;
+
+		// returns the newest version any component in the chunk's column was changed or added in
+		uint32 chunk_version(size_t chunk, size_t column) const;
+
+		// marks the component at the row as changed in the version
+		void set_changed(size_t row, size_t column, uint32 version);
+
+		// marks every component in the chunk's column as changed in the version
+		void set_chunk_changed(size_t chunk, size_t column, uint32 version);
+
+		// marks the component at the row as added and changed in the version
+		void set_added(size_t row, size_t column, uint32 version);
+
+		// returns the component at the row
+		void* get(size_t row, size_t column) const;
+
+		// returns the entity at the row
+		entity* get_entity(size_t row) const;
+
+		// makes room for rows more rows without allocating
+		void reserve(size_t rows);
+
+		// adds a row for the entity and returns its index
+		// the components are left unconstructed and must be constructed by the caller
+		size_t emplace(entity* e);
+
+		// moves the row into the other archetype and returns the new row
+		// components missing from the other archetype are destroyed
+		// components missing from this archetype are left unconstructed
+		size_t relocate(size_t row, archetype* other);
+
+		// destroys the components in the row and removes it
+		void erase(size_t row);
+
+		// destroys every component and removes every row at once without moving any rows
+		void clear();
+
+	private:
+		signature m_signature;
+		std::vector<size_t> m_columnLookup; // indexed by typehash
+		std::vector<size_t> m_offsets;
+		std::vector<size_t> m_versionOffsets; // changed versions, added versions follow each
+		std::vector<uint32> m_chunkVersions; // chunk * column count + column
+		size_t m_chunkCapacity;
+		size_t m_chunkAlloc;
+		size_t m_chunkAlign;
+		size_t m_size;
+		std::vector<std::byte*> m_chunks;
+		std::vector<std::byte*> m_spareChunks;
+		std::pmr::memory_resource* m_resource;
+
+		// removes a row whose components were already destroyed or moved out
+		void remove_row(size_t row);
+
+		// copies the versions of a row's column to another row's column
+		void copy_versions(size_t row, size_t column, const archetype* other, size_t otherRow, size_t otherColumn);
+
+		// adds a chunk to the end, reusing an old one if there is one
+		void add_chunk();
+
+		// gives a chunk back to the heap or the memory_resource
+		void free_chunk(std::byte* chunk);
+
+		std::unordered_map<const detail::component_info*, archetype*> m_addEdges;
+		std::unordered_map<const detail::component_info*, archetype*> m_removeEdges;
+	public:
+		archetype* __get_add_edge(const detail::component_info* info) const;
+		archetype* __get_remove_edge(const detail::component_info* info) const;
+		void __set_add_edge(const detail::component_info* info, archetype* arch);
+		void __set_remove_edge(const detail::component_info* info, archetype* arch);
+	};
+
+
+	// implementations
+
+	namespace detail {
+
+		template<typename Ty>
+		inline void(*get_copy_function())(void*, const void*) {
+			if constexpr (std::is_copy_constructible_v<Ty>)
+				return [](void* dst, const void* src) { new (dst) Ty(*static_cast<const Ty*>(src)); };
+			else
+				return nullptr;
+		}
+
+		template<typename Ty>
+		inline const component_info* get_component_info() {
+			static const component_info info{
+				get_typehash<Ty>(),
+				sizeof(Ty),
+				alignof(Ty),
+				[](void* dst, void* src) {
+					Ty* s = static_cast<Ty*>(src);
+					new (dst) Ty(std::move(*s));
+					s->~Ty();
+				},
+				get_copy_function<Ty>(),
+				[](void* ptr) { static_cast<Ty*>(ptr)->~Ty(); },
+				[](void* ptr)-> component* { return static_cast<Ty*>(ptr); }
+			};
+			return &info;
+		}
+
+		inline bool component_info_less(const component_info* lhs, const component_info* rhs) {
+			return lhs->type < rhs->type;
+		}
+
+	}
+
+	template<typename Ty>
+	inline Ty* archetype::column(size_t chunk, size_t column_) const {
+		return static_cast<Ty*>(column(chunk, column_));
+	}
+
+}
+
+#endif // !ALC_ENTITIES_ARCHETYPE_HPP
\ No newline at end of file
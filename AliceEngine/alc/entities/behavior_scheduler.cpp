@@ -0,0 +1,319 @@
+#include "behavior_scheduler.hpp"
+#include "entity_factory.hpp"
+#include "../jobs/job_system.hpp"
+#include "../core/profiler.hpp"
+#include <algorithm>
+
+namespace alc {
+
+	namespace {
+		thread_local bool t_parallelUpdate = false;
+	}
+
+	// behavior_access
+
+	bool behavior_access::conflicts(const behavior_access& other) const {
+		// write/write and write/read on the same type
+		auto intersects = [](const std::vector<typehash>& a, const std::vector<typehash>& b) {
+			size_t i = 0, j = 0;
+			while (i < a.size() && j < b.size()) {
+				if (a[i] == b[j]) return true;
+				if (a[i] < b[j]) ++i;
+				else ++j;
+			}
+			return false;
+		};
+		return intersects(m_writes, other.m_reads) || intersects(other.m_writes, m_reads);
+	}
+
+	const std::vector<typehash>& behavior_access::get_reads() const {
+		return m_reads;
+	}
+
+	const std::vector<typehash>& behavior_access::get_writes() const {
+		return m_writes;
+	}
+
+	void behavior_access::insert(std::vector<typehash>& list, typehash type) {
+		auto it = std::lower_bound(list.begin(), list.end(), type);
+		if (it == list.end() || *it != type) list.insert(it, type);
+	}
+
+	// behavior_scheduler
+
+	namespace {
+		constexpr uint32 no_lane = static_cast<uint32>(-1);
+	}
+
+	behavior_scheduler::behavior_scheduler() : m_batchSize(64), m_phasesDirty(false), m_time(0.0), m_frame(0) { }
+
+	behavior_scheduler::~behavior_scheduler() { }
+
+	void behavior_scheduler::remove(behavior* b) {
+		{
+			std::lock_guard<std::mutex> _(m_requestLock);
+			m_rescheduled.erase(std::remove(m_rescheduled.begin(), m_rescheduled.end(), b), m_rescheduled.end());
+			m_woken.erase(std::remove(m_woken.begin(), m_woken.end(), b), m_woken.end());
+		}
+
+		// not added to a group yet
+		if (b->m_lane == no_lane) {
+			m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), b), m_pending.end());
+			return;
+		}
+		unlink(b);
+	}
+
+	void behavior_scheduler::set_update_rate(behavior* b, const update_rate& rate) {
+		std::lock_guard<std::mutex> _(m_requestLock);
+		if (b->m_rate == rate) return;
+		b->m_rate = rate;
+		m_rescheduled.push_back(b);
+	}
+
+	update_rate behavior_scheduler::get_update_rate(const behavior* b) const {
+		std::lock_guard<std::mutex> _(m_requestLock);
+		return b->m_rate;
+	}
+
+	void behavior_scheduler::wake(behavior* b) {
+		std::lock_guard<std::mutex> _(m_requestLock);
+		if (b->m_rate.type != update_rate::mode::when_woken || b->m_wakeRequested) return;
+		b->m_wakeRequested = true;
+		m_woken.push_back(b);
+	}
+
+	void behavior_scheduler::update(timestep ts) {
+		ALC_PROFILE_SCOPE("behavior_scheduler::update");
+		flush_pending();
+		if (m_phasesDirty) build_phases();
+		collect_runs(ts);
+
+		for (auto& phase : m_phases) {
+			run_phase(phase, ts);
+		}
+		for (auto& g : m_groups) g->woken.clear();
+	}
+
+	size_t behavior_scheduler::get_batch_size() const {
+		return m_batchSize;
+	}
+
+	void behavior_scheduler::set_batch_size(size_t size) {
+		m_batchSize = std::max<size_t>(size, 1);
+	}
+
+	void behavior_scheduler::add(behavior* b, typehash type, std::string_view name, bool parallel, const behavior_access& access) {
+		const size_t index = static_cast<size_t>(type);
+		if (index >= m_groupLookup.size()) m_groupLookup.resize(index + 1, nullptr);
+
+		// create the group the first time the type is seen
+		if (m_groupLookup[index] == nullptr) {
+			m_groups.push_back(std::make_unique<group>());
+			group* g = m_groups.back().get();
+			g->type = type;
+			g->index = static_cast<uint32>(m_groups.size() - 1);
+			g->name = profiler::intern(name);
+			g->parallel = parallel;
+			g->access = access;
+			m_groupLookup[index] = g;
+			m_phasesDirty = true;
+		}
+
+		b->m_type = type;
+		b->m_updateIndex = static_cast<size_t>(-1);
+		b->m_lane = no_lane;
+		b->m_lastTime = m_time;
+		b->m_lastFrame = m_frame;
+		m_pending.push_back(b);
+	}
+
+	void behavior_scheduler::insert(behavior* b) {
+		group* g = m_groupLookup[static_cast<size_t>(b->m_type)];
+		const update_rate& rate = b->m_rate;
+
+		// find or make the lane for the rate
+		uint32 laneIndex = 0;
+		while (laneIndex < g->lanes.size() && !(g->lanes[laneIndex].rate == rate)) ++laneIndex;
+		if (laneIndex == g->lanes.size()) {
+			lane& l = g->lanes.emplace_back();
+			l.rate = rate;
+			const uint32 count = rate.type == update_rate::mode::frames ? rate.frames
+				: rate.type == update_rate::mode::seconds ? seconds_buckets : 1;
+			l.buckets.resize(count);
+			for (uint32 i = 0; i < count; i++) {
+				// buckets in seconds are spaced evenly across the interval
+				l.buckets[i].nextTime = m_time + rate.seconds * static_cast<double>(i + 1) / static_cast<double>(count);
+			}
+		}
+		lane& l = g->lanes[laneIndex];
+
+		// the smallest bucket keeps the frames even
+		uint32 bucketIndex = 0;
+		for (uint32 i = 1; i < l.buckets.size(); i++) {
+			if (l.buckets[i].behaviors.size() < l.buckets[bucketIndex].behaviors.size()) bucketIndex = i;
+		}
+		bucket& bk = l.buckets[bucketIndex];
+		b->m_lane = laneIndex;
+		b->m_bucket = bucketIndex;
+		b->m_updateIndex = bk.behaviors.size();
+		bk.behaviors.push_back(b);
+	}
+
+	void behavior_scheduler::unlink(behavior* b) {
+		// swap and pop
+		group* g = m_groupLookup[static_cast<size_t>(b->m_type)];
+		auto& behaviors = g->lanes[b->m_lane].buckets[b->m_bucket].behaviors;
+		behavior* last = behaviors.back();
+		behaviors[b->m_updateIndex] = last;
+		last->m_updateIndex = b->m_updateIndex;
+		behaviors.pop_back();
+		b->m_updateIndex = static_cast<size_t>(-1);
+		b->m_lane = no_lane;
+	}
+
+	void behavior_scheduler::flush_pending() {
+		// rates can be set from other threads while inserting
+		std::lock_guard<std::mutex> _(m_requestLock);
+		for (behavior* b : m_pending) insert(b);
+		m_pending.clear();
+
+		for (behavior* b : m_rescheduled) {
+			if (b->m_lane == no_lane) continue;
+			unlink(b);
+			insert(b);
+		}
+		m_rescheduled.clear();
+
+		// rates could have changed since waking
+		for (behavior* b : m_woken) {
+			b->m_wakeRequested = false;
+			if (b->m_rate.type == update_rate::mode::when_woken)
+				m_groupLookup[static_cast<size_t>(b->m_type)]->woken.push_back(b);
+		}
+		m_woken.clear();
+	}
+
+	void behavior_scheduler::collect_runs(timestep ts) {
+		m_time += ts.get();
+		++m_frame;
+
+		for (auto& g : m_groups) {
+			g->runs.clear();
+			for (lane& l : g->lanes) {
+				switch (l.rate.type) {
+				case update_rate::mode::every_frame:
+					if (l.buckets[0].behaviors.size() > 0) g->runs.push_back(&l.buckets[0].behaviors);
+					break;
+
+				case update_rate::mode::frames: {
+					bucket& bk = l.buckets[m_frame % l.buckets.size()];
+					if (bk.behaviors.size() > 0) g->runs.push_back(&bk.behaviors);
+					break;
+				}
+
+				case update_rate::mode::seconds:
+					// run every bucket that is due, at most once each
+					for (size_t i = 0; i < l.buckets.size(); i++) {
+						bucket& bk = l.buckets[l.cursor];
+						if (bk.nextTime > m_time) break;
+						// fell behind by more than an interval, dont try to catch up
+						bk.nextTime += l.rate.seconds;
+						if (bk.nextTime <= m_time) bk.nextTime = m_time + l.rate.seconds;
+						l.cursor = (l.cursor + 1) % static_cast<uint32>(l.buckets.size());
+						if (bk.behaviors.size() > 0) g->runs.push_back(&bk.behaviors);
+					}
+					break;
+
+				case update_rate::mode::when_woken:
+					break;
+				}
+			}
+			if (g->woken.size() > 0) g->runs.push_back(&g->woken);
+		}
+	}
+
+	void behavior_scheduler::build_phases() {
+		m_phases.clear();
+		m_phasesDirty = false;
+
+		// each group goes into the first phase after the last phase it conflicts with
+		// this keeps the relative order of conflicting groups
+		for (auto& g : m_groups) {
+			size_t first = 0;
+			for (size_t p = m_phases.size(); p-- > 0;) {
+				bool conflicts = false;
+				for (group* other : m_phases[p]) {
+					if (!g->parallel || !other->parallel || g->access.conflicts(other->access)) {
+						conflicts = true;
+						break;
+					}
+				}
+				if (conflicts) {
+					first = p + 1;
+					break;
+				}
+			}
+			if (first == m_phases.size()) m_phases.emplace_back();
+			m_phases[first].push_back(g.get());
+		}
+	}
+
+	void behavior_scheduler::run_phase(const std::vector<group*>& phase, timestep ts) {
+		// split every due list into batches
+		struct batch { group* g; const std::vector<behavior*>* behaviors; size_t begin; size_t end; uint32 first; };
+		std::vector<batch> batches;
+		for (group* g : phase) {
+			uint32 first = 0;
+			for (const std::vector<behavior*>* behaviors : g->runs) {
+				const size_t size = behaviors->size();
+				for (size_t begin = 0; begin < size; begin += m_batchSize) {
+					batches.push_back({ g, behaviors, begin, std::min(begin + m_batchSize, size), first + static_cast<uint32>(begin) });
+				}
+				first += static_cast<uint32>(size);
+			}
+		}
+
+		// serial groups are always alone in their phase
+		if (phase.size() == 1 && !phase[0]->parallel) {
+			for (const batch& b : batches) update_range(b.g, *b.behaviors, b.begin, b.end, b.first, ts, m_time, m_frame);
+			return;
+		}
+
+		// runs on this thread if the job system isnt running
+		const double time = m_time;
+		const uint64 frame = m_frame;
+		job_system::parallel_for(batches.size(), 1, [&batches, ts, time, frame](size_t begin, size_t end) {
+			const bool wasParallel = t_parallelUpdate;
+			t_parallelUpdate = true;
+			for (size_t i = begin; i < end; i++) {
+				const batch& b = batches[i];
+				update_range(b.g, *b.behaviors, b.begin, b.end, b.first, ts, time, frame);
+			}
+			t_parallelUpdate = wasParallel;
+		});
+	}
+
+	bool behavior_scheduler::is_updating_in_parallel() {
+		return t_parallelUpdate;
+	}
+
+	void behavior_scheduler::update_range(group* g, const std::vector<behavior*>& behaviors, size_t begin, size_t end, uint32 first, timestep ts, double time, uint64 frame) {
+		ALC_PROFILE_SCOPE(g->name);
+		for (size_t i = begin; i < end && i < behaviors.size(); i++) {
+			behavior* b = behaviors[i];
+			if (std::atomic_ref<bool>(b->m_shouldDestroy).load(std::memory_order_relaxed)) continue;
+
+			// behaviors that skipped frames, were woken or changed rate get the time since they last ran
+			const timestep elapsed = b->m_lastFrame + 1 == frame ? ts : timestep(time - b->m_lastTime);
+			b->m_lastTime = time;
+			b->m_lastFrame = frame;
+
+			// commands recorded by the behavior are played back in update order
+			command_buffer::set_sort_key((static_cast<uint64>(g->index + 1) << 32) | (first + (i - begin)));
+			b->on_update(elapsed);
+		}
+		command_buffer::set_sort_key(0);
+	}
+
+}
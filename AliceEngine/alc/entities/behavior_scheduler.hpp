@@ -0,0 +1,226 @@
+#ifndef ALC_ENTITIES_BEHAVIOR_SCHEDULER_HPP
+#define ALC_ENTITIES_BEHAVIOR_SCHEDULER_HPP
+#include "../common.hpp"
+#include "../core/profiler.hpp"
+#include "../datatypes/timestep.hpp"
+#include "../reflection/typehash.hpp"
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+namespace alc {
+
+	class behavior;
+
+	// describes which types a behavior reads and writes during on_update
+	// behaviors declare it with a static function:
+	//     static void declare_access(alc::behavior_access& access) {
+	//         access.read<transform>().write<velocity>();
+	//     }
+	// behaviors that declare their access are updated in parallel and must only touch their own
+	// entity and the declared types, behaviors that dont are updated on the calling thread
+	// destroying and reparenting are safe from parallel updates and are applied at the factory's next sync point,
+	// other structural changes should be recorded in the factory's command_buffer
+	class behavior_access final {
+	public:
+
+		// marks the type as read
+		template<typename Ty> behavior_access& read();
+
+		// marks the type as written, also implies read
+		template<typename Ty> behavior_access& write();
+
+		// returns true if the two cannot run at the same time
+		bool conflicts(const behavior_access& other) const;
+
+		// sorted list of read types
+		const std::vector<typehash>& get_reads() const;
+
+		// sorted list of written types
+		const std::vector<typehash>& get_writes() const;
+
+	private:
+		std::vector<typehash> m_reads;
+		std::vector<typehash> m_writes;
+		static void insert(std::vector<typehash>& list, typehash type);
+	};
+
+	// how often a behavior is updated
+	// behaviors that update less than every frame are spread evenly across the frames so the cost stays flat,
+	// their timestep is the time since they last updated
+	struct update_rate final {
+		enum class mode : uint8 { every_frame, frames, seconds, when_woken };
+
+		mode type = mode::every_frame;
+		uint32 frames = 1;
+		double seconds = 0.0;
+
+		// updates every frame
+		static constexpr update_rate every_frame();
+
+		// updates once every count frames
+		static constexpr update_rate every_frames(uint32 count);
+
+		// updates once every interval seconds
+		static constexpr update_rate every_seconds(double interval);
+
+		// only updates once on the next frame after behavior::wake is called
+		static constexpr update_rate when_woken();
+
+		bool operator==(const update_rate&) const = default;
+	};
+
+	// updates behaviors grouped by type
+	// groups whose access doesnt conflict are placed into the same phase and run at the same time,
+	// each group is split into batches that are spread across the job_system's workers
+	// groups are ordered by when their type was first added
+	// within a group behaviors are split into lanes by update_rate, lanes that update less than every frame
+	// are split into buckets and only the buckets that are due run
+	class behavior_scheduler final {
+		ALC_NO_COPY(behavior_scheduler);
+		ALC_NO_MOVE(behavior_scheduler);
+	public:
+
+		behavior_scheduler();
+		~behavior_scheduler();
+
+		// adds a behavior of type Ty, it will start updating on the next call to update
+		template<typename Ty> void add(Ty* b);
+
+		// removes a behavior
+		// must not be called while updating
+		void remove(behavior* b);
+
+		// changes how often the behavior is updated, takes effect on the next update
+		// can be called from any thread
+		void set_update_rate(behavior* b, const update_rate& rate);
+
+		// how often the behavior is updated
+		// can be called from any thread
+		update_rate get_update_rate(const behavior* b) const;
+
+		// updates a behavior waiting to be woken once on the next update
+		// can be called from any thread
+		void wake(behavior* b);
+
+		// updates all behaviors
+		void update(timestep ts);
+
+		// the number of behaviors in each batch
+		size_t get_batch_size() const;
+
+		// the number of behaviors in each batch
+		void set_batch_size(size_t size);
+
+		// the number of buckets lanes updating every few seconds are split into
+		static constexpr uint32 seconds_buckets = 16;
+
+		// returns true while the calling thread is updating behaviors that run in parallel
+		// changes to state shared between entities have to wait for the next sync point while it is
+		static bool is_updating_in_parallel();
+
+	private:
+		// behaviors that update together
+		struct bucket final {
+			std::vector<behavior*> behaviors;
+			double nextTime = 0.0; // when the bucket runs next, only for lanes in seconds
+		};
+		// behaviors in a group with the same update_rate
+		struct lane final {
+			update_rate rate;
+			std::vector<bucket> buckets;
+			uint32 cursor = 0; // the next bucket to run for lanes in seconds
+		};
+		struct group final {
+			typehash type;
+			uint32 index; // order the group was added in, used for sorting commands
+			profile_name name;
+			bool parallel;
+			behavior_access access;
+			std::vector<lane> lanes;
+			std::vector<behavior*> woken;
+			std::vector<const std::vector<behavior*>*> runs; // the lists that are due this update
+		};
+		std::vector<std::unique_ptr<group>> m_groups;
+		std::vector<group*> m_groupLookup; // indexed by typehash
+		std::vector<std::vector<group*>> m_phases;
+		std::vector<behavior*> m_pending;
+		size_t m_batchSize;
+		bool m_phasesDirty;
+		double m_time;
+		uint64 m_frame;
+
+		// changes requested from other threads
+		mutable std::mutex m_requestLock;
+		std::vector<behavior*> m_rescheduled;
+		std::vector<behavior*> m_woken;
+
+		void add(behavior* b, typehash type, std::string_view name, bool parallel, const behavior_access& access);
+		void insert(behavior* b);
+		void unlink(behavior* b);
+		void flush_pending();
+		void collect_runs(timestep ts);
+		void build_phases();
+		void run_phase(const std::vector<group*>& phase, timestep ts);
+		static void update_range(group* g, const std::vector<behavior*>& behaviors, size_t begin, size_t end, uint32 first, timestep ts, double time, uint64 frame);
+	};
+
+	namespace detail {
+
+		template<typename Ty, typename = void>
+		struct has_declare_access : std::false_type { };
+
+		template<typename Ty>
+		struct has_declare_access<Ty, std::void_t<decltype(Ty::declare_access(std::declval<behavior_access&>()))>>
+			: std::true_type { };
+
+	}
+
+
+	// implementations
+
+	inline constexpr update_rate update_rate::every_frame() {
+		return update_rate();
+	}
+
+	inline constexpr update_rate update_rate::every_frames(uint32 count) {
+		if (count <= 1) return every_frame();
+		return update_rate{ mode::frames, count, 0.0 };
+	}
+
+	inline constexpr update_rate update_rate::every_seconds(double interval) {
+		if (interval <= 0.0) return every_frame();
+		return update_rate{ mode::seconds, 1, interval };
+	}
+
+	inline constexpr update_rate update_rate::when_woken() {
+		return update_rate{ mode::when_woken, 1, 0.0 };
+	}
+
+	template<typename Ty>
+	inline behavior_access& behavior_access::read() {
+		insert(m_reads, get_typehash<Ty>());
+		return *this;
+	}
+
+	template<typename Ty>
+	inline behavior_access& behavior_access::write() {
+		insert(m_reads, get_typehash<Ty>());
+		insert(m_writes, get_typehash<Ty>());
+		return *this;
+	}
+
+	template<typename Ty>
+	inline void behavior_scheduler::add(Ty* b) {
+		behavior_access access;
+		if constexpr (detail::has_declare_access<Ty>::value) {
+			Ty::declare_access(access);
+			add(b, get_typehash<Ty>(), detail::get_typename<Ty>(), true, access);
+		} else {
+			add(b, get_typehash<Ty>(), detail::get_typename<Ty>(), false, access);
+		}
+	}
+
+}
+
+#endif // !ALC_ENTITIES_BEHAVIOR_SCHEDULER_HPP
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "command_buffer.hpp"
+#include "entity_factory.hpp"
+#include <algorithm>
+#include <memory>
+
+namespace alc {
+
+	namespace {
+		thread_local uint64 t_sortKey = 0;
+	}
+
+	// command_target
+
+	command_target::command_target(const entity* e)
+		: m_handle(e ? e->get_handle() : entity_handle()), m_list(not_pending), m_index(0) { }
+
+	// command_list
+
+	void* command_buffer::command_list::allocate(size_t size, size_t align) {
+		// values that can never fit into a block get their own
+		if (size + align > block_size) {
+			size_t space = size + align;
+			oversized.push_back(std::make_unique<std::byte[]>(space));
+			void* ptr = oversized.back().get();
+			return std::align(align, size, ptr, space);
+		}
+
+		while (true) {
+			if (block == blocks.size()) blocks.push_back(std::make_unique<std::byte[]>(block_size));
+			void* ptr = blocks[block].get() + offset;
+			size_t space = block_size - offset;
+			if (std::align(align, size, ptr, space)) {
+				offset = block_size - space + size;
+				return ptr;
+			}
+			++block;
+			offset = 0;
+		}
+	}
+
+	void command_buffer::command_list::reset() {
+		commands.clear();
+		created.clear();
+		createCount = 0;
+		oversized.clear();
+		block = 0;
+		offset = 0;
+	}
+
+	// command_buffer
+
+	command_buffer::command_buffer() : m_playing(list_count + 1) { }
+
+	command_buffer::~command_buffer() {
+		// destroy the values of commands that were never played back
+		auto discard = [](command_list* list) {
+			for (command& c : list->commands) {
+				if (c.type == command_type::add) c.apply(nullptr, c.data);
+			}
+		};
+		for (auto& slot : m_lists) {
+			command_list* list = slot.load(std::memory_order_acquire);
+			if (list == nullptr) continue;
+			discard(list);
+			delete list;
+		}
+		discard(&m_shared);
+	}
+
+	pending_entity command_buffer::create() {
+		const uint64 key = get_sort_key();
+		pending_entity pending;
+		record([&](command_list& list, uint32 index) {
+			pending = pending_entity{ index, list.createCount++ };
+			list.commands.push_back(command{ key, command_type::create, false, pending, nullptr, nullptr, nullptr });
+		});
+		return pending;
+	}
+
+	void command_buffer::destroy(command_target target, bool destroyChildren) {
+		const uint64 key = get_sort_key();
+		record([&](command_list& list, uint32) {
+			list.commands.push_back(command{ key, command_type::destroy, destroyChildren, target, nullptr, nullptr, nullptr });
+		});
+	}
+
+	void command_buffer::set_parent(command_target target, command_target parent) {
+		const uint64 key = get_sort_key();
+		record([&](command_list& list, uint32) {
+			list.commands.push_back(command{ key, command_type::set_parent, false, target, parent, nullptr, nullptr });
+		});
+	}
+
+	uint64 command_buffer::get_sort_key() {
+		return t_sortKey;
+	}
+
+	void command_buffer::set_sort_key(uint64 key) {
+		t_sortKey = key;
+	}
+
+	void command_buffer::__playback(entity_factory* factory) {
+		// take the recorded commands so anything recorded while playing back goes into empty lists
+		for (uint32 i = 0; i < list_count; i++) {
+			if (command_list* list = m_lists[i].load(std::memory_order_acquire)) std::swap(*list, m_playing[i]);
+		}
+		{
+			std::lock_guard<std::mutex> _(m_sharedLock);
+			std::swap(m_shared, m_playing[list_count]);
+		}
+
+		// gather every list in a fixed order so equal keys are played back the same way every time
+		size_t createCount = 0;
+		for (command_list& list : m_playing) {
+			list.created.assign(list.createCount, nullptr);
+			createCount += list.createCount;
+			for (command& c : list.commands) m_sorted.push_back(&c);
+		}
+		if (m_sorted.size() == 0) return;
+
+		std::stable_sort(m_sorted.begin(), m_sorted.end(), [](const command* lhs, const command* rhs) {
+			return lhs->key < rhs->key;
+		});
+
+		// create the whole wave first so any command can refer to them
+		factory->reserve(createCount);
+		for (command* c : m_sorted) {
+			if (c->type == command_type::create)
+				get_list(c->target.m_list)->created[c->target.m_index] = factory->create();
+		}
+
+		for (command* c : m_sorted) {
+			switch (c->type) {
+				case command_type::destroy:
+					if (entity* e = resolve(factory, c->target)) factory->destroy(e, c->destroyChildren);
+					break;
+				case command_type::add:
+					// a missing entity still needs the value destroyed
+					c->apply(resolve(factory, c->target), c->data);
+					break;
+				case command_type::remove:
+					if (entity* e = resolve(factory, c->target)) c->apply(e, nullptr);
+					break;
+				case command_type::set_parent:
+					if (entity* e = resolve(factory, c->target)) {
+						entity* parent = resolve(factory, c->other);
+						if (parent || c->other.is_null()) e->set_parent(parent);
+					}
+					break;
+				default:
+					break;
+			}
+		}
+
+		// every value was moved out or destroyed by its command
+		m_sorted.clear();
+		for (command_list& list : m_playing) list.reset();
+	}
+
+	command_buffer::command_list* command_buffer::get_list(uint32 index) {
+		return &m_playing[index];
+	}
+
+	entity* command_buffer::resolve(entity_factory* factory, const command_target& target) {
+		if (target.m_list != command_target::not_pending) return get_list(target.m_list)->created[target.m_index];
+		return factory->get(target.m_handle);
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,211 @@
+#ifndef ALC_ENTITIES_COMMAND_BUFFER_HPP
+#define ALC_ENTITIES_COMMAND_BUFFER_HPP
+#include "../common.hpp"
+#include "../jobs/job_system.hpp"
+#include "entity_handle.hpp"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+namespace alc {
+
+	class entity;
+	class entity_factory;
+	class command_buffer;
+
+	// an entity that will be created when its command_buffer is played back
+	// can be used as the target of other commands in the same buffer until then
+	struct pending_entity final {
+		uint32 list = 0;
+		uint32 index = 0;
+	};
+
+	// the entity a command applies to, either an existing entity or a pending one
+	struct command_target final {
+		command_target(std::nullptr_t = nullptr);
+		command_target(entity_handle handle);
+		command_target(const entity* e);
+		command_target(pending_entity pending);
+
+		// returns true if this does not refer to any entity
+		bool is_null() const;
+
+	private:
+		friend command_buffer;
+		static constexpr uint32 not_pending = static_cast<uint32>(-1);
+		entity_handle m_handle;
+		uint32 m_list;
+		uint32 m_index;
+	};
+
+	namespace detail {
+
+		// adds a Ty moved from data to the entity, then destroys data
+		// a null entity only destroys data
+		template<typename Ty> void command_add(entity* e, void* data);
+
+		// marks the Ty on the entity for destruction
+		template<typename Ty> void command_remove(entity* e, void* data);
+
+	}
+
+	// records structural changes to a factory's entities so that they can be made from any thread
+	// every job_system worker records into its own list without locking, other threads share a locked list
+	// the factory plays the commands back once per update, after its behaviors have updated
+	// commands are played back sorted by the sort key of the thread that recorded them so the result does not
+	// depend on which worker ran what, commands with the same key keep the order they were recorded in
+	// entities are always created before any other command runs
+	//     pending_entity bullet = commands->create<projectile>(speed);
+	//     commands->set_parent(bullet, get_entity());
+	class command_buffer final {
+		ALC_NO_COPY(command_buffer);
+		ALC_NO_MOVE(command_buffer);
+	public:
+
+		command_buffer();
+		~command_buffer();
+
+		// records creating an entity
+		pending_entity create();
+
+		// records creating an entity with a Ty constructed from args
+		template<typename Ty, typename... Args> pending_entity create(Args&&... args);
+
+		// records marking the entity for destruction
+		// if destroyChildren is false then the children become unparented
+		void destroy(command_target target, bool destroyChildren = true);
+
+		// records adding a component or behavior of type Ty constructed from args
+		template<typename Ty, typename... Args> void add(command_target target, Args&&... args);
+
+		// records marking the component or behavior of type Ty for destruction
+		template<typename Ty> void remove(command_target target);
+
+		// records setting the parent of the entity, a null parent unparents it
+		void set_parent(command_target target, command_target parent);
+
+		// the sort key given to commands recorded on this thread
+		// the behavior_scheduler sets it to each behavior's place in the update order
+		// and resets it to 0 afterwards
+		static uint64 get_sort_key();
+
+		// the sort key given to commands recorded on this thread
+		static void set_sort_key(uint64 key);
+
+		// runs every recorded command on the factory and clears them
+		// commands recorded while playing back, like from on_create, are played back the next time
+		// must not be called while commands are being recorded
+		void __playback(entity_factory* factory);
+
+	private:
+		enum class command_type : uint8 {
+			create, destroy, add, remove, set_parent
+		};
+
+		struct command final {
+			uint64 key;
+			command_type type;
+			bool destroyChildren;
+			command_target target;
+			command_target other;
+			void(*apply)(entity*, void*);
+			void* data;
+		};
+
+		// the commands recorded by one thread
+		// values are constructed into blocks that are kept between playbacks
+		struct command_list final {
+			std::vector<command> commands;
+			std::vector<entity*> created; // filled in by playback
+			uint32 createCount = 0;
+			std::vector<std::unique_ptr<std::byte[]>> blocks;
+			std::vector<std::unique_ptr<std::byte[]>> oversized;
+			size_t block = 0;
+			size_t offset = 0;
+
+			void* allocate(size_t size, size_t align);
+			void reset();
+		};
+
+		static constexpr size_t block_size = 4096;
+		static constexpr uint32 list_count = 64;
+
+		// one list per worker, set by the worker the first time it records
+		std::atomic<command_list*> m_lists[list_count] = { };
+		// threads that are not workers
+		std::mutex m_sharedLock;
+		command_list m_shared;
+		// the lists being played back, swapped with the recording lists so recording during playback is safe
+		// indexed like m_lists with the shared list last, kept to reuse memory
+		std::vector<command_list> m_playing;
+		// kept to reuse memory when playing back
+		std::vector<command*> m_sorted;
+
+		// calls fn(list, listIndex) with the list of the calling thread
+		template<typename Fn> void record(Fn&& fn);
+		command_list* get_list(uint32 index);
+		entity* resolve(entity_factory* factory, const command_target& target);
+	};
+
+
+	// implementations
+
+	inline command_target::command_target(std::nullptr_t)
+		: m_handle(), m_list(not_pending), m_index(0) { }
+
+	inline command_target::command_target(entity_handle handle)
+		: m_handle(handle), m_list(not_pending), m_index(0) { }
+
+	inline command_target::command_target(pending_entity pending)
+		: m_handle(), m_list(pending.list), m_index(pending.index) { }
+
+	inline bool command_target::is_null() const {
+		return m_list == not_pending && m_handle.is_null();
+	}
+
+	template<typename Fn>
+	inline void command_buffer::record(Fn&& fn) {
+		const size_t worker = job_system::get_worker_index();
+		if (worker >= list_count) {
+			std::lock_guard<std::mutex> _(m_sharedLock);
+			fn(m_shared, list_count);
+			return;
+		}
+
+		// only this worker ever sets its own list
+		command_list* list = m_lists[worker].load(std::memory_order_relaxed);
+		if (list == nullptr) {
+			list = new command_list();
+			m_lists[worker].store(list, std::memory_order_release);
+		}
+		fn(*list, static_cast<uint32>(worker));
+	}
+
+	template<typename Ty, typename... Args>
+	inline pending_entity command_buffer::create(Args&&... args) {
+		const pending_entity pending = create();
+		add<Ty>(pending, std::forward<Args>(args)...);
+		return pending;
+	}
+
+	template<typename Ty, typename... Args>
+	inline void command_buffer::add(command_target target, Args&&... args) {
+		const uint64 key = get_sort_key();
+		record([&](command_list& list, uint32) {
+			void* data = new (list.allocate(sizeof(Ty), alignof(Ty))) Ty(std::forward<Args>(args)...);
+			list.commands.push_back(command{ key, command_type::add, false, target, nullptr, &detail::command_add<Ty>, data });
+		});
+	}
+
+	template<typename Ty>
+	inline void command_buffer::remove(command_target target) {
+		const uint64 key = get_sort_key();
+		record([&](command_list& list, uint32) {
+			list.commands.push_back(command{ key, command_type::remove, false, target, nullptr, &detail::command_remove<Ty>, nullptr });
+		});
+	}
+
+}
+
+#endif // !ALC_ENTITIES_COMMAND_BUFFER_HPP
\ No newline at end of file
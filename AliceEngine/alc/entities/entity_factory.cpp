@@ -0,0 +1,908 @@
+#include "entity_factory.hpp"
+#include "prefab.hpp"
+#include "spatial_index.hpp"
+#include "../core/debug.hpp"
+#include "../core/profiler.hpp"
+#include "../core/string_table.hpp"
+#include "../datatypes/memory_arena.hpp"
+#include <algorithm>
+
+namespace alc {
+
+	namespace {
+		constexpr uint32 no_slot = static_cast<uint32>(-1);
+	}
+
+	// component
+
+	entity* component::get_entity() const {
+		return m_entity;
+	}
+
+	void component::__set_entity(entity* _entity) {
+		m_entity = _entity;
+	}
+
+	// behavior
+
+	entity* behavior::get_entity() const {
+		return m_entity;
+	}
+
+	entity* behavior::create() const {
+		return m_entity->create();
+	}
+
+	bool behavior::destroy(entity* entity_, bool destroyChildren) {
+		return m_entity->destroy(entity_, destroyChildren);
+	}
+
+	bool behavior::destroy(component* c) {
+		return m_entity->destroy(c);
+	}
+
+	bool behavior::destroy(behavior* b) {
+		return m_entity->destroy(b);
+	}
+
+	glm::vec3 behavior::get_position() const {
+		return m_entity->get_position();
+	}
+
+	void behavior::set_position(const glm::vec3& position) {
+		m_entity->set_position(position);
+	}
+
+	glm::vec3 behavior::get_relative_position() const {
+		return m_entity->get_relative_position();
+	}
+
+	void behavior::set_relative_position(const glm::vec3& position) {
+		m_entity->set_relative_position(position);
+	}
+
+	glm::quat behavior::get_rotation() const {
+		return m_entity->get_rotation();
+	}
+
+	void behavior::set_rotation(const glm::quat& rotation) {
+		m_entity->set_rotation(rotation);
+	}
+
+	glm::vec3 behavior::get_scale() const {
+		return m_entity->get_scale();
+	}
+
+	void behavior::set_scale(const glm::vec3& scale) {
+		m_entity->set_scale(scale);
+	}
+
+	glm::mat4 behavior::get_world_matrix() const {
+		return m_entity->get_world_matrix();
+	}
+
+	std::string_view behavior::get_name() const {
+		return m_entity->get_name();
+	}
+
+	void behavior::set_name(std::string_view name) {
+		m_entity->set_name(name);
+	}
+
+	entity_factory* behavior::get_factory() const {
+		return m_entity->get_factory();
+	}
+
+	entity* behavior::get_parent() const {
+		return m_entity->get_parent();
+	}
+
+	void behavior::set_parent(entity* parent) {
+		m_entity->set_parent(parent);
+	}
+
+	const std::vector<entity*>& behavior::get_children() const {
+		return m_entity->get_children();
+	}
+
+	void behavior::set_update_rate(const update_rate& rate) {
+		get_factory()->get_scheduler()->set_update_rate(this, rate);
+	}
+
+	update_rate behavior::get_update_rate() const {
+		return get_factory()->get_scheduler()->get_update_rate(this);
+	}
+
+	void behavior::wake() {
+		get_factory()->get_scheduler()->wake(this);
+	}
+
+	void behavior::start(routine&& routine_) {
+		routine::handle_t handle = routine_.__release();
+		if (!handle) return;
+		handle.promise().owner = this;
+		m_routines.push_back(handle.address());
+
+		// routines are only resumed on the engine's thread
+		if (behavior_scheduler::is_updating_in_parallel()) {
+			__defer_routine(handle.address());
+			return;
+		}
+		handle.resume();
+	}
+
+	void behavior::stop_routines() {
+		// destroying a frame cancels whatever it was waiting on
+		std::vector<void*> routines;
+		routines.swap(m_routines);
+		m_routinesToResume.clear();
+		for (void* address : routines) std::coroutine_handle<>::from_address(address).destroy();
+	}
+
+	size_t behavior::get_routine_count() const {
+		return m_routines.size();
+	}
+
+	timer_handle behavior::after(double seconds, const function<void>& fn) {
+		return timers::after(seconds, fn, this);
+	}
+
+	timer_handle behavior::after_updates(uint64 count, const function<void>& fn) {
+		return timers::after_updates(count, fn, this);
+	}
+
+	void behavior::__defer_routine(void* routine_) {
+		if (m_routinesToResume.empty()) get_factory()->__queue_resume(this);
+		m_routinesToResume.push_back(routine_);
+	}
+
+	void behavior::__remove_routine(void* routine_) {
+		auto it = std::find(m_routines.begin(), m_routines.end(), routine_);
+		if (it == m_routines.end()) return;
+		*it = m_routines.back();
+		m_routines.pop_back();
+	}
+
+	namespace detail {
+		void remove_routine(behavior* owner, void* routine_) {
+			owner->__remove_routine(routine_);
+		}
+
+		void resume_routine(behavior* owner, std::coroutine_handle<> routine_) {
+			if (owner == nullptr || owner->get_factory()->__is_attached()) {
+				routine_.resume();
+				return;
+			}
+			owner->__defer_routine(routine_.address());
+		}
+	}
+
+	void behavior::__set_entity(entity* _entity) {
+		m_entity = _entity;
+	}
+
+	// entity
+
+	entity::entity() : entity("") { }
+
+	entity::entity(const std::string& name)
+		: m_factory(nullptr), m_handle(), m_destroyState(0), m_archetype(nullptr), m_row(0), m_transformIndex(transform_system::npos)
+		, m_name(name), m_nameHash(string_table::intern(name)), m_indexedHash(), m_nameSlot(no_slot), m_renameQueued(false)
+		, m_parent(nullptr) { }
+
+	entity::~entity() {
+		__destroy_behaviors();
+	}
+
+	entity* entity::create() const {
+		return m_factory->create();
+	}
+
+	bool entity::destroy(entity* entity_, bool destroyChildren) {
+		return m_factory->destroy(entity_, destroyChildren);
+	}
+
+	bool entity::destroy(component* c) {
+		if (c == nullptr || c->get_entity() != this) return false;
+
+		// find the column that holds the component
+		const archetype::signature& sig = m_archetype->get_signature();
+		for (size_t i = 0; i < sig.size(); i++) {
+			if (sig[i]->to_component(m_archetype->get(m_row, i)) == c) {
+				m_factory->__mark_component(this, sig[i]);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool entity::destroy(behavior* b) {
+		if (b == nullptr || b->get_entity() != this) return false;
+		m_factory->__mark_behavior(b);
+		return true;
+	}
+
+	glm::vec3 entity::get_position() const {
+		return glm::vec3(get_world_matrix()[3]);
+	}
+
+	void entity::set_position(const glm::vec3& position) {
+		if (m_parent) {
+			const glm::mat4 toParent = glm::inverse(m_parent->get_world_matrix());
+			set_relative_position(glm::vec3(toParent * glm::vec4(position, 1.0f)));
+		} else {
+			set_relative_position(position);
+		}
+	}
+
+	glm::vec3 entity::get_relative_position() const {
+		return m_factory->get_transforms()->get_position(m_transformIndex);
+	}
+
+	void entity::set_relative_position(const glm::vec3& position) {
+		m_factory->get_transforms()->set_position(m_transformIndex, position);
+	}
+
+	glm::quat entity::get_rotation() const {
+		return m_factory->get_transforms()->get_rotation(m_transformIndex);
+	}
+
+	void entity::set_rotation(const glm::quat& rotation) {
+		m_factory->get_transforms()->set_rotation(m_transformIndex, rotation);
+	}
+
+	glm::vec3 entity::get_scale() const {
+		return m_factory->get_transforms()->get_scale(m_transformIndex);
+	}
+
+	void entity::set_scale(const glm::vec3& scale) {
+		m_factory->get_transforms()->set_scale(m_transformIndex, scale);
+	}
+
+	glm::mat4 entity::get_world_matrix() const {
+		return m_factory->get_transforms()->get_world_matrix(m_transformIndex);
+	}
+
+	std::string_view entity::get_name() const {
+		return m_name;
+	}
+
+	void entity::set_name(std::string_view name) {
+		if (m_name == name) return;
+		m_name = name;
+		m_nameHash = string_table::intern(name);
+		if (m_factory == nullptr) return;
+
+		// the index is shared with other entities so parallel updates defer the change
+		if (behavior_scheduler::is_updating_in_parallel()) {
+			m_factory->__queue_rename(this);
+			return;
+		}
+		m_factory->__unindex_name(this);
+		m_factory->__index_name(this);
+	}
+
+	hash32_t entity::get_name_hash() const {
+		return m_nameHash;
+	}
+
+	entity_factory* entity::get_factory() const {
+		return m_factory;
+	}
+
+	entity_handle entity::get_handle() const {
+		return m_handle;
+	}
+
+	entity* entity::get_parent() const {
+		return m_parent;
+	}
+
+	void entity::set_parent(entity* parent) {
+		// transforms are indexed per factory
+		if (parent && parent->m_factory != m_factory) {
+			ALC_DEBUG_WARNING("Could not set parent since it belongs to a different entity_factory");
+			return;
+		}
+
+		// the hierarchy is shared with other entities so parallel updates defer the change
+		if (behavior_scheduler::is_updating_in_parallel()) {
+			m_factory->get_commands()->set_parent(this, parent);
+			return;
+		}
+		if (parent == m_parent) return;
+
+		// make sure we dont create a loop
+		for (entity* e = parent; e != nullptr; e = e->m_parent) {
+			if (e == this) {
+				ALC_DEBUG_WARNING("Could not set parent since it would create a loop");
+				return;
+			}
+		}
+
+		// remove from old parent
+		if (m_parent) {
+			auto& siblings = m_parent->m_children;
+			siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+		}
+
+		// add to new parent
+		m_parent = parent;
+		if (m_parent) m_parent->m_children.push_back(this);
+		m_factory->get_transforms()->set_parent(m_transformIndex, m_parent ? m_parent->m_transformIndex : transform_system::npos);
+	}
+
+	const std::vector<entity*>& entity::get_children() const {
+		return m_children;
+	}
+
+	void entity::__set_factory(entity_factory* factory) {
+		if (m_factory) m_factory->__unindex_name(this);
+		m_factory = factory;
+		if (m_factory) m_factory->__index_name(this);
+	}
+
+	void entity::__set_archetype(archetype* arch, size_t row) {
+		m_archetype = arch;
+		m_row = row;
+	}
+
+	void entity::__set_row(size_t row) {
+		m_row = row;
+	}
+
+	void entity::__set_transform_index(uint32 index) {
+		m_transformIndex = index;
+	}
+
+	archetype* entity::__get_archetype() const {
+		return m_archetype;
+	}
+
+	size_t entity::__get_row() const {
+		return m_row;
+	}
+
+	void entity::__destroy_behaviors() {
+		for (behavior* b : m_behaviors) {
+			m_factory->get_scheduler()->remove(b);
+			b->on_destroy();
+			m_factory->__delete_behavior(b);
+		}
+		m_behaviors.clear();
+		m_behaviorLookup.clear();
+	}
+
+	void entity::__remove_behavior(behavior* b) {
+		auto it = std::find(m_behaviors.begin(), m_behaviors.end(), b);
+		if (it == m_behaviors.end()) return;
+		m_behaviors.erase(it);
+		unindex_behavior(b);
+		m_factory->get_scheduler()->remove(b);
+		b->on_destroy();
+		m_factory->__delete_behavior(b);
+	}
+
+	void entity::index_behavior(behavior* b) {
+		const uint32 id = b->m_info->id;
+		if (id >= m_behaviorLookup.size()) m_behaviorLookup.resize(id + 1, nullptr);
+		if (m_behaviorLookup[id] == nullptr) m_behaviorLookup[id] = b;
+	}
+
+	void entity::unindex_behavior(behavior* b) {
+		const uint32 id = b->m_info->id;
+		if (m_behaviorLookup[id] != b) return;
+
+		// the next behavior of the same type takes its place
+		m_behaviorLookup[id] = nullptr;
+		for (behavior* other : m_behaviors) {
+			if (other->m_info == b->m_info) {
+				m_behaviorLookup[id] = other;
+				break;
+			}
+		}
+	}
+
+	// entity_factory
+
+	namespace {
+		// factories created on this thread are added here instead of listening to onUpdate
+		thread_local std::vector<entity_factory*>* t_staged = nullptr;
+	}
+
+	entity_factory::entity_factory(size_t reserve)
+		: m_resource(memory_arena::get_current()), m_entityPool(sizeof(entity), alignof(entity), m_resource), m_freeSlot(no_slot), m_transforms(reserve)
+		, m_version(1), m_historyVersions{ }, m_historyIndex(0), m_timersPaused(false) {
+		m_entities.reserve(reserve);
+		m_entitySlots.reserve(reserve);
+		m_slots.reserve(reserve);
+
+		// the empty archetype always lives at index 0
+		m_archetypes.push_back(std::make_unique<archetype>(archetype::signature(), m_resource));
+
+		m_group = t_staged;
+		if (m_group) m_group->push_back(this);
+		else __attach();
+	}
+
+	entity_factory::~entity_factory() {
+		if (m_group) m_group->erase(std::remove(m_group->begin(), m_group->end(), this), m_group->end());
+		alice_events::onUpdate.unsubscribe(m_updateToken);
+
+		// everything goes at once, so the names, removals and rows are not kept up to date one entity at a time
+		m_names.clear();
+		for (entity* e : m_entities) {
+			e->__destroy_behaviors();
+			archetype* arch = e->__get_archetype();
+			const archetype::signature& sig = arch->get_signature();
+			for (size_t i = 0; i < sig.size(); i++) {
+				sig[i]->to_component(arch->get(e->__get_row(), i))->on_destroy();
+			}
+		}
+		for (auto& arch : m_archetypes) arch->clear();
+		for (entity* e : m_entities) {
+			e->~entity();
+			m_entityPool.deallocate(e);
+		}
+		m_entities.clear();
+		m_entitySlots.clear();
+		m_slots.clear();
+		m_entitiesToDestroy.clear();
+		m_componentsToDestroy.clear();
+		m_behaviorsToDestroy.clear();
+	}
+
+	entity* entity_factory::create() {
+		return create_entity(m_archetypes[0].get());
+	}
+
+	entity* entity_factory::instantiate(const prefab& prefab_) {
+		std::vector<entity*> roots;
+		instantiate(prefab_, 1, &roots);
+		return roots.size() > 0 ? roots[0] : nullptr;
+	}
+
+	void entity_factory::instantiate(const prefab& prefab_, size_t count, std::vector<entity*>* roots) {
+		const auto& nodes = prefab_.m_nodes;
+		if (count == 0 || nodes.size() == 0) return;
+
+		// find every archetype once and make room for all of the copies
+		reserve(nodes.size() * count);
+		std::vector<archetype*> archetypes(nodes.size());
+		std::vector<std::pair<archetype*, size_t>> rows;
+		for (size_t n = 0; n < nodes.size(); n++) {
+			archetypes[n] = find_archetype(nodes[n].signature);
+			auto it = std::find_if(rows.begin(), rows.end(), [&](const auto& p) { return p.first == archetypes[n]; });
+			if (it == rows.end()) rows.emplace_back(archetypes[n], count);
+			else it->second += count;
+		}
+		for (auto& [arch, rowCount] : rows) arch->reserve(rowCount);
+		if (roots) roots->reserve(roots->size() + count);
+
+		std::vector<entity*> created(nodes.size());
+		for (size_t i = 0; i < count; i++) {
+			// copy the data straight into the archetypes
+			for (size_t n = 0; n < nodes.size(); n++) {
+				const prefab::node& node = nodes[n];
+				archetype* arch = archetypes[n];
+				entity* e = create_entity(arch);
+				const size_t row = e->__get_row();
+				for (size_t c = 0; c < node.signature.size(); c++) {
+					void* component_ = arch->get(row, c);
+					node.signature[c]->copy(component_, node.components + node.offsets[c]);
+					node.signature[c]->to_component(component_)->__set_entity(e);
+					arch->set_added(row, c, get_version());
+				}
+				e->set_name(node.name);
+				m_transforms.set_position(e->m_transformIndex, node.position);
+				m_transforms.set_rotation(e->m_transformIndex, node.rotation);
+				m_transforms.set_scale(e->m_transformIndex, node.scale);
+				if (node.parent != prefab::npos) e->set_parent(created[node.parent]);
+				created[n] = e;
+			}
+
+			// then send creation events once the whole copy exists, components can move while handling them
+			for (size_t n = 0; n < nodes.size(); n++) {
+				entity* e = created[n];
+				for (auto* info : nodes[n].signature) {
+					archetype* arch = e->__get_archetype();
+					const size_t column = arch->column_of(info);
+					if (column != archetype::npos) info->to_component(arch->get(e->__get_row(), column))->on_create();
+				}
+				for (const behavior* b : nodes[n].behaviors) b->m_info->add_copy(e, b);
+			}
+			if (roots) roots->push_back(created[0]);
+		}
+	}
+
+	bool entity_factory::destroy(entity* entity_, bool destroyChildren) {
+		if (entity_ == nullptr || entity_->get_factory() != this) return false;
+		std::lock_guard<std::mutex> _(m_destroyLock);
+		if (entity_->m_destroyState == 3) return true;
+		if (entity_->m_destroyState == 0) m_entitiesToDestroy.push_back(entity_);
+		entity_->m_destroyState = std::max<int8>(entity_->m_destroyState, destroyChildren ? 2 : 1);
+		return true;
+	}
+
+	bool entity_factory::destroy(entity_handle handle, bool destroyChildren) {
+		entity* e = get(handle);
+		return e && destroy(e, destroyChildren);
+	}
+
+	entity* entity_factory::get(entity_handle handle) const {
+		if (handle.index >= m_slots.size()) return nullptr;
+		const slot& s = m_slots[handle.index];
+		if (s.generation != handle.generation || handle.is_null()) return nullptr;
+		return m_entities[s.dense];
+	}
+
+	entity* entity_factory::find(std::string_view name) const {
+		auto it = m_names.find(hash_string(name));
+		if (it == m_names.end()) return nullptr;
+		for (entity* e : it->second) {
+			// different names can have the same hash
+			if (e->get_name() == name) return e;
+		}
+		return nullptr;
+	}
+
+	bool entity_factory::is_alive(entity_handle handle) const {
+		return get(handle) != nullptr;
+	}
+
+	size_t entity_factory::size() const {
+		return m_entities.size();
+	}
+
+	void entity_factory::reserve(size_t count) {
+		m_entities.reserve(m_entities.size() + count);
+		m_entitySlots.reserve(m_entitySlots.size() + count);
+		m_slots.reserve(m_slots.size() + count);
+		m_transforms.reserve(count);
+	}
+
+	behavior_scheduler* entity_factory::get_scheduler() {
+		return &m_scheduler;
+	}
+
+	transform_system* entity_factory::get_transforms() {
+		return &m_transforms;
+	}
+
+	command_buffer* entity_factory::get_commands() {
+		return &m_commands;
+	}
+
+	std::pmr::memory_resource* entity_factory::get_memory_resource() const {
+		return m_resource;
+	}
+
+	void entity_factory::__on_update(timestep ts) {
+		prune_removals();
+		m_scheduler.update(ts);
+
+		// names changed while updating in parallel
+		for (entity* e : m_renamed) {
+			e->m_renameQueued = false;
+			__unindex_name(e);
+			__index_name(e);
+		}
+		m_renamed.clear();
+
+		// routines started while updating in parallel or woken while detached
+		for (size_t i = 0; i < m_resuming.size(); i++) {
+			std::vector<void*> routines;
+			routines.swap(m_resuming[i]->m_routinesToResume);
+			for (void* address : routines) std::coroutine_handle<>::from_address(address).resume();
+		}
+		m_resuming.clear();
+
+		// sync point, apply the changes recorded while updating
+		m_commands.__playback(this);
+
+		// remove destroyed behaviors
+		for (behavior* b : m_behaviorsToDestroy) {
+			b->get_entity()->__remove_behavior(b);
+		}
+		m_behaviorsToDestroy.clear();
+
+		// remove destroyed components
+		for (auto& [e, info] : m_componentsToDestroy) {
+			__remove_component(e, info);
+		}
+		m_componentsToDestroy.clear();
+
+		if (m_entitiesToDestroy.size() > 0) destroy_entities();
+
+		// recompute world transforms once everything has moved
+		m_transforms.update(get_version());
+
+		{
+			ALC_PROFILE_SCOPE("spatial_index::__update");
+			for (spatial_index* index : m_spatialIndices) index->__update();
+		}
+	}
+
+	void entity_factory::destroy_entities() {
+		// collect destroyed entities and their children, the dying state keeps each in the list once
+		std::vector<entity*> stack;
+		for (entity* e : m_entitiesToDestroy) {
+			const bool withChildren = e->m_destroyState == 2;
+			if (e->m_destroyState != 3) {
+				e->m_destroyState = 3;
+				m_dying.push_back(e);
+			}
+			if (!withChildren) continue;
+
+			// children may already be dying without their own children, so keep walking through them
+			stack.assign(e->m_children.begin(), e->m_children.end());
+			while (stack.size() > 0) {
+				entity* top = stack.back();
+				stack.pop_back();
+				if (top->m_destroyState != 3) {
+					top->m_destroyState = 3;
+					m_dying.push_back(top);
+				}
+				stack.insert(stack.end(), top->m_children.begin(), top->m_children.end());
+			}
+		}
+		m_entitiesToDestroy.clear();
+
+		// detach from the hierarchy, surviving children become unparented
+		for (entity* e : m_dying) {
+			while (e->m_children.size() > 0) e->m_children.back()->set_parent(nullptr);
+			e->set_parent(nullptr);
+		}
+
+		for (entity* e : m_dying) {
+			release_slot(e);
+			destroy_entity(e);
+		}
+		m_dying.clear();
+	}
+
+	entity* entity_factory::create_entity(archetype* arch) {
+		entity* e = new (m_entityPool.allocate()) entity();
+		e->__set_factory(this);
+		e->__set_archetype(arch, arch->emplace(e));
+
+		// take a free slot or add a new one
+		uint32 index = m_freeSlot;
+		if (index != no_slot) {
+			m_freeSlot = m_slots[index].dense;
+		} else {
+			index = static_cast<uint32>(m_slots.size());
+			m_slots.push_back(slot{ no_slot, 1 });
+		}
+		m_slots[index].dense = static_cast<uint32>(m_entities.size());
+		m_entities.push_back(e);
+		m_entitySlots.push_back(index);
+		e->m_handle = entity_handle{ index, m_slots[index].generation };
+		e->m_transformIndex = m_transforms.create(e);
+		return e;
+	}
+
+	archetype* entity_factory::find_archetype(const archetype::signature& signature_) {
+		for (auto& arch : m_archetypes) {
+			if (arch->get_signature() == signature_) return arch.get();
+		}
+		m_archetypes.push_back(std::make_unique<archetype>(signature_, m_resource));
+		return m_archetypes.back().get();
+	}
+
+	void entity_factory::release_slot(entity* e) {
+		const uint32 index = e->m_handle.index;
+		const uint32 dense = m_slots[index].dense;
+
+		// swap and pop the dense list
+		const uint32 last = static_cast<uint32>(m_entities.size() - 1);
+		if (dense != last) {
+			m_entities[dense] = m_entities[last];
+			m_entitySlots[dense] = m_entitySlots[last];
+			m_slots[m_entitySlots[dense]].dense = dense;
+		}
+		m_entities.pop_back();
+		m_entitySlots.pop_back();
+
+		// invalidate handles and put the slot on the free list, generation 0 is kept for null handles
+		slot& s = m_slots[index];
+		if (++s.generation == 0) s.generation = 1;
+		s.dense = m_freeSlot;
+		m_freeSlot = index;
+	}
+
+	void entity_factory::destroy_entity(entity* e) {
+		e->__destroy_behaviors();
+		__unindex_name(e);
+		for (spatial_index* index : m_spatialIndices) index->remove(e);
+		m_transforms.destroy(e->m_transformIndex);
+
+		archetype* arch = e->__get_archetype();
+		const archetype::signature& sig = arch->get_signature();
+		for (size_t i = 0; i < sig.size(); i++) {
+			sig[i]->to_component(arch->get(e->__get_row(), i))->on_destroy();
+			record_removal(e, sig[i]);
+		}
+		arch->erase(e->__get_row());
+
+		e->~entity();
+		m_entityPool.deallocate(e);
+	}
+
+	void entity_factory::record_removal(entity* e, const detail::component_info* info) {
+		const size_t index = static_cast<size_t>(info->type);
+		if (index >= m_removals.size()) m_removals.resize(index + 1);
+		m_removals[index].push_back(removal{ e->m_handle, get_version() });
+	}
+
+	void entity_factory::prune_removals() {
+		// drop everything older than the start of the update removed_history updates ago
+		const uint32 oldest = m_historyVersions[m_historyIndex];
+		m_historyVersions[m_historyIndex] = get_version();
+		m_historyIndex = (m_historyIndex + 1) % removed_history;
+		for (auto& removals : m_removals) {
+			auto it = std::partition_point(removals.begin(), removals.end(), [oldest](const removal& r) { return r.version < oldest; });
+			removals.erase(removals.begin(), it);
+		}
+	}
+
+	void* entity_factory::__add_component(entity* e, const detail::component_info* info) {
+		archetype* arch = e->__get_archetype();
+
+		// find the archetype with the added type
+		archetype* target = arch->__get_add_edge(info);
+		if (target == nullptr) {
+			archetype::signature sig = arch->get_signature();
+			sig.insert(std::lower_bound(sig.begin(), sig.end(), info, detail::component_info_less), info);
+			target = find_archetype(sig);
+			arch->__set_add_edge(info, target);
+			target->__set_remove_edge(info, arch);
+		}
+
+		// move the entity over
+		const size_t row = arch->relocate(e->__get_row(), target);
+		const size_t column = target->column_of(info);
+		e->__set_archetype(target, row);
+		target->set_added(row, column, get_version());
+		return target->get(row, column);
+	}
+
+	void entity_factory::__remove_component(entity* e, const detail::component_info* info) {
+		archetype* arch = e->__get_archetype();
+		const size_t column = arch->column_of(info);
+		if (column == archetype::npos) return;
+
+		info->to_component(arch->get(e->__get_row(), column))->on_destroy();
+		record_removal(e, info);
+
+		// find the archetype without the type
+		archetype* target = arch->__get_remove_edge(info);
+		if (target == nullptr) {
+			archetype::signature sig = arch->get_signature();
+			sig.erase(sig.begin() + column);
+			target = find_archetype(sig);
+			arch->__set_remove_edge(info, target);
+			target->__set_add_edge(info, arch);
+		}
+
+		// moving the entity destroys the component
+		const size_t row = arch->relocate(e->__get_row(), target);
+		e->__set_archetype(target, row);
+	}
+
+	void entity_factory::__mark_component(entity* e, const detail::component_info* info) {
+		std::lock_guard<std::mutex> _(m_destroyLock);
+		m_componentsToDestroy.emplace_back(e, info);
+	}
+
+	void entity_factory::__mark_behavior(behavior* b) {
+		// the scheduler reads the flag while other behaviors update
+		std::lock_guard<std::mutex> _(m_destroyLock);
+		std::atomic_ref<bool> shouldDestroy(b->m_shouldDestroy);
+		if (shouldDestroy.load(std::memory_order_relaxed)) return;
+		shouldDestroy.store(true, std::memory_order_relaxed);
+		m_behaviorsToDestroy.push_back(b);
+	}
+
+	void* entity_factory::__allocate_behavior(typehash type, size_t size, size_t align) {
+		const size_t index = static_cast<size_t>(type);
+		if (index >= m_behaviorPools.size()) m_behaviorPools.resize(index + 1);
+		if (!m_behaviorPools[index]) m_behaviorPools[index] = std::make_unique<pool_allocator>(size, align, m_resource);
+		return m_behaviorPools[index]->allocate();
+	}
+
+	void entity_factory::__index_name(entity* e) {
+		// unnamed entities are left out
+		if (e->m_name.empty()) return;
+		std::vector<entity*>& named = m_names[e->m_nameHash];
+		e->m_indexedHash = e->m_nameHash;
+		e->m_nameSlot = static_cast<uint32>(named.size());
+		named.push_back(e);
+	}
+
+	void entity_factory::__unindex_name(entity* e) {
+		if (e->m_nameSlot == no_slot) return;
+
+		// swap and pop
+		auto it = m_names.find(e->m_indexedHash);
+		std::vector<entity*>& named = it->second;
+		entity* last = named.back();
+		named[e->m_nameSlot] = last;
+		last->m_nameSlot = e->m_nameSlot;
+		named.pop_back();
+		if (named.size() == 0) m_names.erase(it);
+		e->m_nameSlot = no_slot;
+	}
+
+	void entity_factory::__queue_rename(entity* e) {
+		std::lock_guard<std::mutex> _(m_renameLock);
+		if (e->m_renameQueued) return;
+		e->m_renameQueued = true;
+		m_renamed.push_back(e);
+	}
+
+	void entity_factory::__queue_resume(behavior* b) {
+		std::lock_guard<std::mutex> _(m_resumeLock);
+		m_resuming.push_back(b);
+	}
+
+	void entity_factory::__add_spatial_index(spatial_index* index) {
+		m_spatialIndices.push_back(index);
+	}
+
+	void entity_factory::__remove_spatial_index(spatial_index* index) {
+		m_spatialIndices.erase(std::remove(m_spatialIndices.begin(), m_spatialIndices.end(), index), m_spatialIndices.end());
+	}
+
+	void entity_factory::__attach() {
+		if (!m_updateToken.is_valid()) m_updateToken = alice_events::onUpdate.subscribe(make_function<&entity_factory::__on_update>(this));
+
+		// continue the timers paused when detached
+		if (!m_timersPaused) return;
+		m_timersPaused = false;
+		for (entity* e : m_entities) {
+			for (behavior* b : e->m_behaviors) timers::resume_owned(b);
+		}
+	}
+
+	void entity_factory::__detach() {
+		alice_events::onUpdate.unsubscribe(m_updateToken);
+
+		// timers of behaviors that are not updated shouldnt run out,
+		// factories of preloaded scenes were never attached but still pause here
+		if (m_timersPaused) return;
+		m_timersPaused = true;
+		for (entity* e : m_entities) {
+			for (behavior* b : e->m_behaviors) timers::pause_owned(b);
+		}
+	}
+
+	bool entity_factory::__is_attached() const {
+		return m_updateToken.is_valid();
+	}
+
+	bool entity_factory::__are_timers_paused() const {
+		return m_timersPaused;
+	}
+
+	void entity_factory::__set_group(std::vector<entity_factory*>* group) {
+		m_group = group;
+	}
+
+	void entity_factory::__begin_staging(std::vector<entity_factory*>* staged) {
+		t_staged = staged;
+	}
+
+	void entity_factory::__end_staging() {
+		t_staged = nullptr;
+	}
+
+	void entity_factory::__delete_behavior(behavior* b) {
+		// the type is gone once destroyed
+		const size_t index = static_cast<size_t>(b->m_type);
+		b->stop_routines();
+		timers::cancel_owned(b);
+		m_behaviorPools[index]->deallocate(b->m_info->destroy(b));
+	}
+
+}
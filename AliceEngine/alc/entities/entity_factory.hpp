@@ -2,7 +2,19 @@
 #define ALC_ENTITIES_ENTITY_FACTORY_HPP
 #include "../common.hpp"
 #include "../datatypes/hash.hpp"
+#include "../datatypes/pool_allocator.hpp"
+#include "../reflection/typehash.hpp"
 #include "../core/alice_events.hpp"
+#include "archetype.hpp"
+#include "behavior_scheduler.hpp"
+#include "transform_system.hpp"
+#include "entity_handle.hpp"
+#include "command_buffer.hpp"
+#include "routine.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 
 namespace alc {
 
@@ -10,8 +22,42 @@ namespace alc {
 	class behavior;
 	class entity;
 	class entity_factory;
+	class prefab;
+	class spatial_index;
+
+	namespace detail {
+
+		// type erased information about a behavior type
+		// used by prefabs to copy behaviors
+		struct behavior_info final {
+			typehash type;
+
+			// dense index counted only over behavior types, used by entities to find behaviors
+			uint32 id;
+
+			// copies the behavior onto the heap, null if the type cannot be copied
+			behavior* (*clone)(const behavior* b);
+
+			// adds a copy of the behavior to the entity
+			behavior* (*add_copy)(entity* e, const behavior* b);
+
+			// destroys the behavior and returns the address it was allocated at,
+			// which is not the base's address when the behavior has more than one base
+			void* (*destroy)(behavior* b);
+		};
+
+		// returns the behavior_info for the type
+		template<typename Ty>
+		const behavior_info* get_behavior_info();
+
+		// the number of behavior ids handed out so far
+		std::atomic<uint32>& behavior_counter();
+
+	}
 
 	// components hold data in an entity
+	// components are stored by value inside of the entity's archetype and are moved when
+	// the entity's set of components change, so pointers to them should not be held onto
 	struct component {
 
 		virtual ~component() = 0 { }
@@ -29,14 +75,20 @@ namespace alc {
 
 	private:
 		friend entity;
+		friend entity_factory;
+		friend prefab;
 		entity* m_entity;
 		void __set_entity(entity* _entity);
 	};
 
 	// behaviors contain logic and data in an entity
+	// copying a behavior only copies the derived type's data, the copy is not attached to anything
 	class behavior {
 	public:
 
+		behavior() = default;
+		behavior(const behavior&) { }
+		behavior& operator=(const behavior&) { return *this; }
 		virtual ~behavior() = 0 { }
 
 		// returns the entity that this is attached to
@@ -50,23 +102,33 @@ namespace alc {
 
 		// marks an entity for destruction
 		// if destroyChildren is false then the children become unparented
+		// can be called from parallel behavior updates
 		bool destroy(entity* entity_, bool destroyChildren = true);
 
-		// adds a component of type Ty
-		template<typename Ty> Ty* add();
+		// adds a component or behavior of type Ty constructed from args
+		// if the entity already has the component then the existing one is returned
+		template<typename Ty, typename... Args> Ty* add(Args&&... args);
 
-		// returns a component of type Ty
+		// returns a component or behavior of exactly type Ty
 		template<typename Ty> Ty* get();
 
-		// returns multiple components of type Ty
+		// returns true if the entity has a component or behavior of exactly type Ty
+		template<typename Ty> bool has() const;
+
+		// marks the component of type Ty as changed so each_changed finds it
+		template<typename Ty> void set_changed();
+
+		// returns multiple components or behaviors of exactly type Ty
 		template<typename Ty, typename Container> size_t get(Container* container);
 
 		// marks a component for destruction
 		// returns false if it was not found, was null, or was not attached to anything
+		// can be called from parallel behavior updates
 		bool destroy(component* c);
 
 		// marks a behavior for destruction
 		// returns false if it was not found, was null, or was not attached to anything
+		// can be called from parallel behavior updates
 		bool destroy(behavior* b);
 
 		// the position in world space
@@ -81,11 +143,27 @@ namespace alc {
 		// the position relative to the parent
 		void set_relative_position(const glm::vec3& position);
 
+		// the rotation relative to the parent
+		glm::quat get_rotation() const;
+
+		// the rotation relative to the parent
+		void set_rotation(const glm::quat& rotation);
+
+		// the scale relative to the parent
+		glm::vec3 get_scale() const;
+
+		// the scale relative to the parent
+		void set_scale(const glm::vec3& scale);
+
+		// the transform from local space to world space
+		glm::mat4 get_world_matrix() const;
+
 		// the name of this entity
-		std::string get_name() const;
+		// the view is valid until the name changes
+		std::string_view get_name() const;
 
 		// the name of this entity
-		void set_name(const std::string& name);
+		void set_name(std::string_view name);
 
 		// returns the factory this is attached to
 		entity_factory* get_factory() const;
@@ -93,9 +171,45 @@ namespace alc {
 		// the parent of this entity, can be null
 		entity* get_parent() const;
 
-		// the parent of this entity, can be null
+		// the parent of this entity, can be null, must belong to the same factory
+		// when called from a parallel update the change is recorded in the command_buffer
+		// and applied at the factory's next sync point
 		void set_parent(entity* parent);
 
+		// the entities parented to this one
+		const std::vector<entity*>& get_children() const;
+
+		// how often on_update is called, takes effect on the next update
+		// can be called from any thread
+		void set_update_rate(const update_rate& rate);
+
+		// how often on_update is called
+		update_rate get_update_rate() const;
+
+		// calls on_update once on the next update if the update rate is when_woken
+		// can be called from any thread
+		void wake();
+
+		// starts the routine, it runs until it first waits
+		// the routine is destroyed when it finishes or when this behavior is destroyed
+		// when called from a parallel update the routine first runs at the factory's next sync point
+		void start(routine&& routine_);
+
+		// destroys every routine this behavior started
+		// must not be called from inside of one of them
+		void stop_routines();
+
+		// returns the number of routines that have not finished
+		size_t get_routine_count() const;
+
+		// calls fn once after the delay in seconds, see timers
+		// the timer is cancelled when this behavior is destroyed
+		timer_handle after(double seconds, const function<void>& fn);
+
+		// calls fn once after count updates, see timers
+		// the timer is cancelled when this behavior is destroyed
+		timer_handle after_updates(uint64 count, const function<void>& fn);
+
 	protected:
 
 		// creation event
@@ -105,16 +219,38 @@ namespace alc {
 		virtual void on_destroy() { }
 
 		// step event
+		// behaviors that declare their access (see behavior_access) are updated in parallel
+		// the timestep is the time since the last call, see update_rate
 		virtual void on_update(timestep ts) { }
 
 	private:
 		friend entity;
-		entity* m_entity;
+		friend entity_factory;
+		friend behavior_scheduler;
+		friend prefab;
+		entity* m_entity = nullptr;
+		const detail::behavior_info* m_info = nullptr;
+		typehash m_type{};
+		size_t m_updateIndex = static_cast<size_t>(-1);
+		uint32 m_lane = static_cast<uint32>(-1);
+		uint32 m_bucket = 0;
+		update_rate m_rate;
+		double m_lastTime = 0.0; // scheduler time of the last update
+		uint64 m_lastFrame = 0; // scheduler frame of the last update
+		bool m_wakeRequested = false;
+		bool m_shouldDestroy = false;
+		std::vector<void*> m_routines; // addresses of the running coroutines
+		std::vector<void*> m_routinesToResume; // started during a parallel update or woken while detached, run at the sync point
 		void __set_entity(entity* _entity);
+	public:
+		void __remove_routine(void* routine_);
+		void __defer_routine(void* routine_);
 	};
 
 	// object that holds components and behaviors
 	class entity final {
+		friend entity_factory;
+		friend prefab;
 	public:
 
 		entity();
@@ -131,13 +267,24 @@ namespace alc {
 		// if destroyChildren is false then the children become unparented
 		bool destroy(entity* entity_, bool destroyChildren = true);
 
-		// adds a component of type Ty
-		template<typename Ty> Ty* add();
+		// adds a component or behavior of type Ty constructed from args
+		// if the entity already has the component then the existing one is returned
+		template<typename Ty, typename... Args> Ty* add(Args&&... args);
 
-		// returns a component of type Ty
+		// returns a component or behavior of exactly type Ty
+		// found in constant time using the archetype's lookup table or the behavior lookup
 		template<typename Ty> Ty* get();
 
-		// returns multiple components of type Ty
+		// returns a component or behavior of exactly type Ty
+		template<typename Ty> const Ty* get() const;
+
+		// returns true if the entity has a component or behavior of exactly type Ty
+		template<typename Ty> bool has() const;
+
+		// marks the component of type Ty as changed so each_changed finds it
+		template<typename Ty> void set_changed();
+
+		// returns multiple components or behaviors of exactly type Ty
 		template<typename Ty, typename Container> size_t get(Container* container);
 
 		// marks a component for destruction
@@ -160,66 +307,324 @@ namespace alc {
 		// the position relative to the parent
 		void set_relative_position(const glm::vec3& position);
 
+		// the rotation relative to the parent
+		glm::quat get_rotation() const;
+
+		// the rotation relative to the parent
+		void set_rotation(const glm::quat& rotation);
+
+		// the scale relative to the parent
+		glm::vec3 get_scale() const;
+
+		// the scale relative to the parent
+		void set_scale(const glm::vec3& scale);
+
+		// the transform from local space to world space
+		glm::mat4 get_world_matrix() const;
+
 		// the name of this entity
-		std::string get_name() const;
+		// the view is valid until the name changes
+		std::string_view get_name() const;
 
 		// the name of this entity
-		void set_name(const std::string& name);
+		// when called from a parallel update the factory finds the entity by its new name after its next sync point
+		void set_name(std::string_view name);
+
+		// returns the hash of the name
+		hash32_t get_name_hash() const;
 
 		// returns the factory this is attached to
 		entity_factory* get_factory() const;
 
+		// returns the handle that refers to this entity
+		entity_handle get_handle() const;
+
 		// the parent of this entity, can be null
 		entity* get_parent() const;
 
-		// the parent of this entity, can be null
+		// the parent of this entity, can be null, must belong to the same factory
 		void set_parent(entity* parent);
 
+		// the entities parented to this one
+		const std::vector<entity*>& get_children() const;
+
 	private:
 
 		entity_factory* m_factory;
+		entity_handle m_handle;
+		int8 m_destroyState; // 1 = destroy, 2 = destroy with children, 3 = dying
 
-		std::vector<std::pair<component*, bool>> m_components;
-		std::vector<std::pair<behavior*, bool>> m_behaviors;
+		archetype* m_archetype;
+		size_t m_row;
+		std::vector<behavior*> m_behaviors;
 
-		glm::vec3 m_position;
+		// the first behavior of every type, indexed by behavior id
+		std::vector<behavior*> m_behaviorLookup;
+		void index_behavior(behavior* b);
+		void unindex_behavior(behavior* b);
+		template<typename Ty> Ty* find() const;
+
+		uint32 m_transformIndex;
 		std::string m_name;
 		hash32_t m_nameHash;
+		hash32_t m_indexedHash; // the hash the factory finds the entity by
+		uint32 m_nameSlot; // index in the factory's list for the hash, npos if not found by name
+		bool m_renameQueued;
 
 		entity* m_parent;
 		std::vector<entity*> m_children;
 
-		bool m_isUpdating;
-		void __on_update(timestep ts);
-
 	public:
 		void __set_factory(entity_factory* factory);
+		void __set_archetype(archetype* arch, size_t row);
+		void __set_row(size_t row);
+		void __set_transform_index(uint32 index);
+		archetype* __get_archetype() const;
+		size_t __get_row() const;
+		void __destroy_behaviors();
+		void __remove_behavior(behavior* b);
 	};
 
 	// a list of entities
-	// listens to alice_events::onUpdate to update the entities
+	// components are stored in archetypes, where entities with the same set of components share
+	// contiguous chunks of memory and can be iterated over linearly using each
+	// listens to alice_events::onUpdate and updates behaviors through its behavior_scheduler
+	// then plays back its command_buffer, updates the world transforms through its transform_system
+	// and moves entities in its spatial_indexes
+	// entities and behaviors are allocated from pools owned by the factory, one per behavior type
+	// changes are tracked with versions, components remember the version they were added and last changed in
+	// and systems keep the version they last ran in to only visit what changed since then:
+	//     const uint32 now = factory->advance_version();
+	//     factory->each_changed<const health>(m_lastRun, [](entity* e, const health& h) { ... });
+	//     m_lastRun = now;
+	// factories created while a scene is created, loaded or initialized belong to that scene, they are not updated
+	// until the scene_manager attaches them and stop being updated while the scene is pooled
+	// entities, behaviors and component chunks come from the memory_arena that was current when the factory was created
 	class entity_factory final {
-		ALC_STATIC_CLASS(entity_factory);
+		ALC_NO_COPY(entity_factory);
+		ALC_NO_MOVE(entity_factory);
 	public:
 
 		entity_factory(size_t reserve = 0);
 		~entity_factory();
 
 		// creates a new entity
-		entity* create() const;
+		entity* create();
 
 		// creates an entity with the component of type Ty and returns it
 		template<typename Ty> Ty* create();
 
+		// creates a copy of the prefab and returns its root
+		entity* instantiate(const prefab& prefab_);
+
+		// creates count copies of the prefab, storage for all of them is reserved up front
+		// the roots are added to roots if it is not null
+		void instantiate(const prefab& prefab_, size_t count, std::vector<entity*>* roots = nullptr);
+
 		// marks an entity for destruction
 		// if destroyChildren is false then the children become unparented
 		bool destroy(entity* entity_, bool destroyChildren = true);
 
+		// marks an entity for destruction
+		// returns false if the handle is stale
+		bool destroy(entity_handle handle, bool destroyChildren = true);
+
+		// returns the entity the handle refers to or null if it was destroyed
+		entity* get(entity_handle handle) const;
+
+		// returns true if the handle refers to an entity that has not been destroyed yet
+		// entities marked for destruction are alive until the end of the update
+		bool is_alive(entity_handle handle) const;
+
+		// returns an entity with the name or null if there is none
+		// names are looked up by their hash so this does not walk the entities
+		entity* find(std::string_view name) const;
+
+		// adds every entity with the name to the container and returns how many were added
+		template<typename Container> size_t find_all(std::string_view name, Container* container) const;
+
+		// returns the number of entities
+		size_t size() const;
+
+		// makes room for count more entities without reallocating
+		void reserve(size_t count);
+
+		// calls fn for every entity that has all of the component types
+		// fn can take either (Tys&...) or (entity*, Tys&...)
+		// types that are not const are marked as changed, use const for types that are only read
+		// components must not be added or removed while iterating
+		template<typename... Tys, typename Fn> void each(Fn&& fn);
+
+		// same as each but only for entities whose first component type was changed or added after the version
+		// chunks without changes are skipped without looking at their rows
+		template<typename... Tys, typename Fn> void each_changed(uint32 since, Fn&& fn);
+
+		// same as each but only for entities that gained the first component type after the version
+		template<typename... Tys, typename Fn> void each_added(uint32 since, Fn&& fn);
+
+		// calls fn(entity_handle) for every entity that lost the component type after the version,
+		// including entities that were destroyed
+		// removals are only kept for removed_history updates
+		template<typename Ty, typename Fn> void each_removed(uint32 since, Fn&& fn) const;
+
+		// calls fn(entity*) for every entity whose world transform changed after the version
+		// transforms are stamped when the factory updates them
+		template<typename Fn> void each_moved(uint32 since, Fn&& fn) const;
+
+		// the number of updates removals are kept for
+		static constexpr size_t removed_history = 4;
+
+		// returns the version that changes are currently stamped with
+		uint32 get_version() const;
+
+		// returns the current version and starts a new one
+		// changes made after this are newer than the returned version
+		uint32 advance_version();
+
+		// returns the number of entities that have all of the component types
+		template<typename... Tys> size_t count() const;
+
+		// returns the scheduler that updates the behaviors
+		behavior_scheduler* get_scheduler();
+
+		// returns the transforms of the entities
+		transform_system* get_transforms();
+
+		// returns the buffer for recording changes from any thread
+		command_buffer* get_commands();
+
+		// returns the memory entities, behaviors and components are allocated from, null if it is the heap
+		std::pmr::memory_resource* get_memory_resource() const;
+
 	private:
-		std::vector<std::pair<entity*, int8>> m_entities;
+		// slot map, entities are dense and each slot points to its entity's dense index
+		// free slots are linked through their dense index
+		struct slot final {
+			uint32 dense;
+			uint32 generation;
+		};
+		struct removal final {
+			entity_handle handle;
+			uint32 version;
+		};
+		enum class change_filter : uint8 { none, changed, added };
+		std::pmr::memory_resource* m_resource;
+		pool_allocator m_entityPool;
+		std::vector<std::unique_ptr<pool_allocator>> m_behaviorPools; // indexed by typehash
+		std::vector<entity*> m_entities;
+		std::vector<uint32> m_entitySlots; // the slot of each dense entity
+		std::vector<slot> m_slots;
+		uint32 m_freeSlot;
+		std::mutex m_destroyLock; // guards the lists of things to destroy, they can be marked from any thread
+		std::vector<entity*> m_entitiesToDestroy;
+		std::vector<entity*> m_dying;
+		std::vector<std::unique_ptr<archetype>> m_archetypes;
+		std::vector<std::pair<entity*, const detail::component_info*>> m_componentsToDestroy;
+		std::vector<behavior*> m_behaviorsToDestroy;
+		behavior_scheduler m_scheduler;
+		transform_system m_transforms;
+		command_buffer m_commands;
+		std::vector<spatial_index*> m_spatialIndices;
+		std::unordered_map<hash32_t, std::vector<entity*>> m_names; // named entities by their name hash
+
+		// entities renamed during parallel updates, indexed again at the sync point
+		std::mutex m_renameLock;
+		std::vector<entity*> m_renamed;
+
+		// behaviors with routines to resume at the sync point
+		std::mutex m_resumeLock;
+		std::vector<behavior*> m_resuming;
+		std::atomic<uint32> m_version;
+		std::vector<std::vector<removal>> m_removals; // indexed by typehash
+		uint32 m_historyVersions[removed_history];
+		size_t m_historyIndex;
+		event_token m_updateToken;
+		bool m_timersPaused; // the timers of the behaviors were paused by __detach
+		std::vector<entity_factory*>* m_group; // the factories of the scene this belongs to
 		void __on_update(timestep ts);
+
+		archetype* find_archetype(const archetype::signature& signature_);
+		entity* create_entity(archetype* arch);
+		void destroy_entities();
+		void destroy_entity(entity* e);
+		void release_slot(entity* e);
+		void record_removal(entity* e, const detail::component_info* info);
+		void prune_removals();
+		template<change_filter Filter, typename... Tys, typename Fn> void each_filtered(uint32 since, Fn&& fn);
+
+	public:
+		void* __add_component(entity* e, const detail::component_info* info);
+		void __remove_component(entity* e, const detail::component_info* info);
+		void __mark_component(entity* e, const detail::component_info* info);
+		void __mark_behavior(behavior* b);
+		void* __allocate_behavior(typehash type, size_t size, size_t align);
+		void __delete_behavior(behavior* b);
+		void __index_name(entity* e);
+		void __unindex_name(entity* e);
+		void __queue_rename(entity* e);
+		void __queue_resume(behavior* b);
+		void __add_spatial_index(spatial_index* index);
+		void __remove_spatial_index(spatial_index* index);
+		void __attach();
+		void __detach();
+		bool __is_attached() const;
+		bool __are_timers_paused() const;
+		void __set_group(std::vector<entity_factory*>* group);
+		static void __begin_staging(std::vector<entity_factory*>* staged);
+		static void __end_staging();
 	};
 
+	namespace detail {
+
+		inline std::atomic<uint32>& behavior_counter() {
+			static std::atomic<uint32> counter = 0;
+			return counter;
+		}
+
+		template<typename Ty>
+		inline const behavior_info* get_behavior_info() {
+			static const behavior_info info{
+				get_typehash<Ty>(),
+				behavior_counter().fetch_add(1),
+				[](const behavior* b)-> behavior* {
+					if constexpr (std::is_copy_constructible_v<Ty>) return new Ty(*static_cast<const Ty*>(b));
+					else return nullptr;
+				},
+				[](entity* e, const behavior* b)-> behavior* {
+					if constexpr (std::is_copy_constructible_v<Ty>) return e->add<Ty>(*static_cast<const Ty*>(b));
+					else return nullptr;
+				},
+				[](behavior* b)-> void* {
+					Ty* object = static_cast<Ty*>(b);
+					object->~Ty();
+					return object;
+				}
+			};
+			return &info;
+		}
+
+		template<typename Ty>
+		inline void command_add(entity* e, void* data) {
+			Ty* value = static_cast<Ty*>(data);
+			if (e) e->add<Ty>(std::move(*value));
+			value->~Ty();
+		}
+
+		template<typename Ty>
+		inline void command_remove(entity* e, void* data) {
+			e->destroy(e->get<Ty>());
+		}
+
+		template<typename Fn, typename... Tys, size_t... I>
+		inline void each_row(Fn& fn, size_t row, entity** entities, void** columns, std::index_sequence<I...>) {
+			if constexpr (std::is_invocable_v<Fn&, entity*, Tys&...>)
+				fn(entities[row], static_cast<Tys*>(columns[I])[row]...);
+			else
+				fn(static_cast<Tys*>(columns[I])[row]...);
+		}
+
+	}
+
 
 	// implementations for templates
 
@@ -228,9 +633,9 @@ namespace alc {
 		return get_entity()->create<Ty>();
 	}
 
-	template<typename Ty>
-	inline Ty* behavior::add() {
-		return get_entity()->add<Ty>();
+	template<typename Ty, typename... Args>
+	inline Ty* behavior::add(Args&&... args) {
+		return get_entity()->add<Ty>(std::forward<Args>(args)...);
 	}
 
 	template<typename Ty>
@@ -243,30 +648,47 @@ namespace alc {
 		return get_entity()->get<Ty>(container);
 	}
 
+	template<typename Ty>
+	inline bool behavior::has() const {
+		return get_entity()->has<Ty>();
+	}
+
+	template<typename Ty>
+	inline void behavior::set_changed() {
+		get_entity()->set_changed<Ty>();
+	}
+
 	template<typename Ty>
 	inline Ty* entity::create() {
 		return get_factory()->create<Ty>();
 	}
 
-	template<typename Ty>
-	inline Ty* entity::add() {
+	template<typename Ty, typename... Args>
+	inline Ty* entity::add(Args&&... args) {
 		// add behavior
 		if constexpr (std::is_base_of_v<behavior, Ty>) {
-			if (!m_isUpdating) {
-				alice_events::onUpdate += make_function<&entity::__on_update>(this);
-				m_isUpdating = true;
-			}
-			behavior* b = new Ty();
-			m_behaviors.emplace_back(b, false);
-			b->__set_entity(this);
-			b->on_create();
+			void* memory = m_factory->__allocate_behavior(get_typehash<Ty>(), sizeof(Ty), alignof(Ty));
+			Ty* b = new (memory) Ty(std::forward<Args>(args)...);
+			behavior* base = b;
+			m_behaviors.push_back(base);
+			base->__set_entity(this);
+			base->m_info = detail::get_behavior_info<Ty>();
+			index_behavior(base);
+			m_factory->get_scheduler()->add(b);
+			// a detached factory keeps the timers of new behaviors paused too
+			if (m_factory->__are_timers_paused()) timers::pause_owned(base);
+			base->on_create();
+			return b;
 		}
 		// add component
-		if constexpr (std::is_base_of_v<component, Ty>) {
-			component* c = new Ty();
-			m_components.emplace_back(c, false);
-			c->__set_entity(this);
-			c->on_create();
+		else if constexpr (std::is_base_of_v<component, Ty>) {
+			// only one component of each type can exist on an entity
+			if (Ty* existing = get<Ty>()) return existing;
+			Ty* c = new (m_factory->__add_component(this, detail::get_component_info<Ty>())) Ty(std::forward<Args>(args)...);
+			component* base = c;
+			base->__set_entity(this);
+			base->on_create();
+			return c;
 		}
 
 		// did not create any components, return nullptr
@@ -275,21 +697,27 @@ namespace alc {
 
 	template<typename Ty>
 	inline Ty* entity::get() {
+		return find<Ty>();
+	}
+
+	template<typename Ty>
+	inline const Ty* entity::get() const {
+		return find<Ty>();
+	}
+
+	template<typename Ty>
+	inline Ty* entity::find() const {
 		// behaviors
 		if constexpr (std::is_base_of_v<behavior, Ty>) {
-			for (size_t i = 0; i < m_behaviors.size(); i++) {
-				if (Ty* b = dynamic_cast<Ty*>(m_behaviors[i].first); b != nullptr) {
-					return b;
-				}
-			}
+			const uint32 id = detail::get_behavior_info<Ty>()->id;
+			if (id < m_behaviorLookup.size()) return static_cast<Ty*>(m_behaviorLookup[id]);
 		}
 
 		// components
-		if constexpr (std::is_base_of_v<component, Ty>) {
-			for (size_t i = 0; i < m_components.size(); i++) {
-				if (Ty* c = dynamic_cast<Ty*>(m_components[i].first); c != nullptr) {
-					return c;
-				}
+		else if constexpr (std::is_base_of_v<component, Ty>) {
+			const size_t column = m_archetype->column_of(get_typehash<Ty>());
+			if (column != archetype::npos) {
+				return static_cast<Ty*>(m_archetype->get(m_row, column));
 			}
 		}
 
@@ -297,27 +725,43 @@ namespace alc {
 		return nullptr;
 	}
 
+	template<typename Ty>
+	inline bool entity::has() const {
+		if constexpr (std::is_base_of_v<behavior, Ty>)
+			return get<Ty>() != nullptr;
+		else if constexpr (std::is_base_of_v<component, Ty>)
+			return m_archetype->has(get_typehash<Ty>());
+		return false;
+	}
+
+	template<typename Ty>
+	inline void entity::set_changed() {
+		static_assert(std::is_base_of_v<component, Ty>, "only components track changes");
+		const size_t column = m_archetype->column_of(get_typehash<Ty>());
+		if (column != archetype::npos) m_archetype->set_changed(m_row, column, m_factory->get_version());
+	}
+
 	template<typename Ty, typename Container>
 	inline size_t entity::get(Container* container) {
 		size_t count = 0;
 
 		// behaviors
 		if constexpr (std::is_base_of_v<behavior, Ty>) {
-			for (size_t i = 0; i < m_behaviors.size(); i++) {
-				if (Ty* b = dynamic_cast<Ty*>(m_behaviors[i].first); b != nullptr) {
-					container->push_back(b);
+			const detail::behavior_info* info = detail::get_behavior_info<Ty>();
+			if (info->id < m_behaviorLookup.size() && m_behaviorLookup[info->id]) {
+				for (behavior* b : m_behaviors) {
+					if (b->m_info != info) continue;
+					container->push_back(static_cast<Ty*>(b));
 					count++;
 				}
 			}
 		}
 
 		// components
-		if constexpr (std::is_base_of_v<component, Ty>) {
-			for (size_t i = 0; i < m_components.size(); i++) {
-				if (Ty* c = dynamic_cast<Ty*>(m_components[i].first); c != nullptr) {
-					container->push_back(c);
-					count++;
-				}
+		else if constexpr (std::is_base_of_v<component, Ty>) {
+			if (Ty* c = get<Ty>(); c != nullptr) {
+				container->push_back(c);
+				count++;
 			}
 		}
 
@@ -334,6 +778,123 @@ namespace alc {
 		return nullptr;
 	}
 
+	template<typename... Tys, typename Fn>
+	inline void entity_factory::each(Fn&& fn) {
+		each_filtered<change_filter::none, Tys...>(0, fn);
+	}
+
+	template<typename... Tys, typename Fn>
+	inline void entity_factory::each_changed(uint32 since, Fn&& fn) {
+		each_filtered<change_filter::changed, Tys...>(since, fn);
+	}
+
+	template<typename... Tys, typename Fn>
+	inline void entity_factory::each_added(uint32 since, Fn&& fn) {
+		each_filtered<change_filter::added, Tys...>(since, fn);
+	}
+
+	template<typename Ty, typename Fn>
+	inline void entity_factory::each_removed(uint32 since, Fn&& fn) const {
+		const size_t index = static_cast<size_t>(get_typehash<Ty>());
+		if (index >= m_removals.size()) return;
+		// newest are at the back
+		const auto& removals = m_removals[index];
+		auto it = std::partition_point(removals.begin(), removals.end(), [since](const removal& r) { return r.version <= since; });
+		for (; it != removals.end(); ++it) fn(it->handle);
+	}
+
+	template<typename Fn>
+	inline void entity_factory::each_moved(uint32 since, Fn&& fn) const {
+		m_transforms.each_changed(since, [this, &fn](uint32 index) {
+			if (entity* e = m_transforms.get_owner(index)) fn(e);
+		});
+	}
+
+	template<typename Container>
+	inline size_t entity_factory::find_all(std::string_view name, Container* container) const {
+		auto it = m_names.find(hash_string(name));
+		if (it == m_names.end()) return 0;
+		size_t count = 0;
+		for (entity* e : it->second) {
+			// different names can have the same hash
+			if (e->get_name() != name) continue;
+			container->push_back(e);
+			count++;
+		}
+		return count;
+	}
+
+	inline uint32 entity_factory::get_version() const {
+		return m_version.load(std::memory_order_relaxed);
+	}
+
+	inline uint32 entity_factory::advance_version() {
+		return m_version.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template<entity_factory::change_filter Filter, typename... Tys, typename Fn>
+	inline void entity_factory::each_filtered(uint32 since, Fn&& fn) {
+		static_assert(sizeof...(Tys) > 0, "each requires at least one component type");
+		const detail::component_info* infos[] = { detail::get_component_info<std::remove_const_t<Tys>>()... };
+		constexpr bool writes[] = { !std::is_const_v<Tys>... };
+		const uint32 version = get_version();
+
+		for (auto& arch : m_archetypes) {
+			if (arch->size() == 0) continue;
+
+			// find the columns, skip archetypes that are missing any of the types
+			size_t columns[sizeof...(Tys)];
+			bool matches = true;
+			for (size_t i = 0; i < sizeof...(Tys) && matches; i++) {
+				columns[i] = arch->column_of(infos[i]);
+				matches = columns[i] != archetype::npos;
+			}
+			if (!matches) continue;
+
+			// walk each chunk linearly
+			for (size_t chunk = 0; chunk < arch->chunk_count(); chunk++) {
+				if constexpr (Filter != change_filter::none) {
+					if (arch->chunk_version(chunk, columns[0]) <= since) continue;
+				}
+				const size_t count = arch->chunk_size(chunk);
+				entity** entities = arch->entities(chunk);
+				void* data[sizeof...(Tys)];
+				for (size_t i = 0; i < sizeof...(Tys); i++)
+					data[i] = arch->column(chunk, columns[i]);
+
+				if constexpr (Filter == change_filter::none) {
+					for (size_t row = 0; row < count; row++)
+						detail::each_row<Fn, Tys...>(fn, row, entities, data, std::index_sequence_for<Tys...>{});
+					for (size_t i = 0; i < sizeof...(Tys); i++)
+						if (writes[i]) arch->set_chunk_changed(chunk, columns[i], version);
+				} else {
+					const uint32* versions = Filter == change_filter::changed
+						? arch->changed_versions(chunk, columns[0]) : arch->added_versions(chunk, columns[0]);
+					const size_t first = chunk * arch->chunk_capacity();
+					for (size_t row = 0; row < count; row++) {
+						if (versions[row] <= since) continue;
+						detail::each_row<Fn, Tys...>(fn, row, entities, data, std::index_sequence_for<Tys...>{});
+						for (size_t i = 0; i < sizeof...(Tys); i++)
+							if (writes[i]) arch->set_changed(first + row, columns[i], version);
+					}
+				}
+			}
+		}
+	}
+
+	template<typename... Tys>
+	inline size_t entity_factory::count() const {
+		static_assert(sizeof...(Tys) > 0, "count requires at least one component type");
+		const detail::component_info* infos[] = { detail::get_component_info<std::remove_const_t<Tys>>()... };
+		size_t total = 0;
+		for (auto& arch : m_archetypes) {
+			bool matches = true;
+			for (auto* info : infos) matches = matches && arch->has(info);
+			if (matches) total += arch->size();
+		}
+		return total;
+	}
+
 }
 
 #endif // !ALC_ENTITIES_ENTITY_FACTORY_HPP
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef ALC_ENTITIES_ENTITY_HANDLE_HPP
+#define ALC_ENTITIES_ENTITY_HANDLE_HPP
+#include "../common.hpp"
+
+namespace alc {
+
+	// a reference to an entity that can tell when the entity has been destroyed
+	// the index points into the factory's slot map and the generation changes every time the slot is reused
+	// a default constructed handle is null
+	struct entity_handle final {
+		uint32 index = 0;
+		uint32 generation = 0;
+
+		// returns true if this never referred to an entity
+		bool is_null() const;
+
+		// packs the handle into a single value
+		uint64 value() const;
+
+		// unpacks a handle from value()
+		static entity_handle from_value(uint64 value);
+
+		bool operator==(const entity_handle& other) const;
+		bool operator!=(const entity_handle& other) const;
+	};
+
+
+	// implementations
+
+	inline bool entity_handle::is_null() const {
+		return generation == 0;
+	}
+
+	inline uint64 entity_handle::value() const {
+		return (static_cast<uint64>(generation) << 32) | index;
+	}
+
+	inline entity_handle entity_handle::from_value(uint64 value) {
+		return entity_handle{ static_cast<uint32>(value), static_cast<uint32>(value >> 32) };
+	}
+
+	inline bool entity_handle::operator==(const entity_handle& other) const {
+		return index == other.index && generation == other.generation;
+	}
+
+	inline bool entity_handle::operator!=(const entity_handle& other) const {
+		return !operator==(other);
+	}
+
+}
+
+#endif // !ALC_ENTITIES_ENTITY_HANDLE_HPP
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "prefab.hpp"
+#include "../core/debug.hpp"
+#include <algorithm>
+
+namespace alc {
+
+	prefab::prefab(const entity* root) {
+		if (root == nullptr) return;
+
+		// depth first so parents come first
+		std::vector<std::pair<const entity*, uint32>> stack;
+		stack.emplace_back(root, npos);
+		while (stack.size() > 0) {
+			auto [e, parent] = stack.back();
+			stack.pop_back();
+			const uint32 index = static_cast<uint32>(m_nodes.size());
+			capture(e, parent);
+			const auto& children = e->get_children();
+			for (size_t i = children.size(); i > 0; i--) stack.emplace_back(children[i - 1], index);
+		}
+	}
+
+	prefab::~prefab() {
+		for (node& n : m_nodes) {
+			for (size_t c = 0; c < n.signature.size(); c++) {
+				n.signature[c]->destroy(n.components + n.offsets[c]);
+			}
+			::operator delete(n.components, std::align_val_t(n.align));
+			for (behavior* b : n.behaviors) delete b;
+		}
+	}
+
+	void prefab::capture(const entity* e, uint32 parent) {
+		node& n = m_nodes.emplace_back();
+		n.name = e->get_name();
+		n.parent = parent;
+		n.position = e->get_relative_position();
+		n.rotation = e->get_rotation();
+		n.scale = e->get_scale();
+
+		// lay the copyable components out in one block
+		const archetype* arch = e->__get_archetype();
+		const archetype::signature& sig = arch->get_signature();
+		size_t size = 0;
+		n.align = alignof(std::max_align_t);
+		for (auto* info : sig) {
+			if (info->copy == nullptr) {
+				ALC_DEBUG_WARNING("Could not capture a component that cannot be copied");
+				continue;
+			}
+			size = (size + info->align - 1) & ~(info->align - 1);
+			n.signature.push_back(info);
+			n.offsets.push_back(size);
+			size += info->size;
+			n.align = std::max(n.align, info->align);
+		}
+		n.components = static_cast<std::byte*>(::operator new(std::max<size_t>(size, 1), std::align_val_t(n.align)));
+
+		// the copies are not attached to anything
+		for (size_t c = 0; c < n.signature.size(); c++) {
+			const detail::component_info* info = n.signature[c];
+			void* copy = n.components + n.offsets[c];
+			info->copy(copy, arch->get(e->__get_row(), arch->column_of(info)));
+			info->to_component(copy)->__set_entity(nullptr);
+		}
+
+		for (behavior* b : e->m_behaviors) {
+			behavior* copy = b->m_info->clone(b);
+			if (copy == nullptr) {
+				ALC_DEBUG_WARNING("Could not capture a behavior that cannot be copied");
+				continue;
+			}
+			copy->m_info = b->m_info;
+			n.behaviors.push_back(copy);
+		}
+	}
+
+}
\ No newline at end of file
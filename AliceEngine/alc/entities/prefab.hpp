@@ -0,0 +1,57 @@
+#ifndef ALC_ENTITIES_PREFAB_HPP
+#define ALC_ENTITIES_PREFAB_HPP
+#include "../common.hpp"
+#include "entity_factory.hpp"
+
+namespace alc {
+
+	// an immutable copy of an entity and its children that can be instantiated any number of times
+	// stores copies of the components, behaviors, names and relative transforms
+	// components and behaviors that cannot be copied are left out
+	//     prefab enemy(template_);
+	//     factory->instantiate(enemy, 5000);
+	class prefab final {
+		ALC_NO_COPY(prefab);
+		ALC_NO_MOVE(prefab);
+	public:
+
+		// captures the entity and all of its children
+		prefab(const entity* root);
+		~prefab();
+
+		// returns the number of entities in a single copy
+		size_t size() const;
+
+	private:
+		friend entity_factory;
+
+		static constexpr uint32 npos = static_cast<uint32>(-1);
+
+		// a captured entity, parents always come before their children
+		struct node final {
+			std::string name;
+			uint32 parent;
+			glm::vec3 position;
+			glm::quat rotation;
+			glm::vec3 scale;
+			archetype::signature signature;
+			std::vector<size_t> offsets;
+			std::byte* components; // one copy per type in the signature
+			size_t align;
+			std::vector<behavior*> behaviors;
+		};
+		std::vector<node> m_nodes;
+
+		void capture(const entity* e, uint32 parent);
+	};
+
+
+	// implementations
+
+	inline size_t prefab::size() const {
+		return m_nodes.size();
+	}
+
+}
+
+#endif // !ALC_ENTITIES_PREFAB_HPP
\ No newline at end of file
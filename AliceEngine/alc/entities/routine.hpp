@@ -0,0 +1,274 @@
+#ifndef ALC_ENTITIES_ROUTINE_HPP
+#define ALC_ENTITIES_ROUTINE_HPP
+#include "../common.hpp"
+#include "../core/alice_events.hpp"
+#include "../core/timers.hpp"
+#include <coroutine>
+#include <exception>
+#include <optional>
+
+namespace alc {
+
+	class behavior;
+
+	namespace detail {
+		// removes a finished routine from the behavior that started it
+		void remove_routine(behavior* owner, void* routine_);
+
+		// resumes the routine, or at the factory's next sync point if the owner's factory is not being updated
+		void resume_routine(behavior* owner, std::coroutine_handle<> routine_);
+	}
+
+	// a coroutine started by a behavior with behavior::start
+	// routines run on the engine's thread and are only resumed once what they wait on happens,
+	// so a waiting routine costs nothing per frame
+	//     routine patrol() {
+	//         while (true) {
+	//             co_await wait_seconds(2.0);
+	//             const alarm_event ev = co_await wait_until<alarm_event>();
+	//             co_await chase(ev.source); // runs another routine until it finishes
+	//         }
+	//     }
+	// destroying the behavior destroys its routines and cancels whatever they were waiting on
+	// while the behavior's scene is pooled its routines are suspended, waits in time are paused
+	// and routines woken by events continue once the scene is active again
+	// routines do not start until they are started or awaited
+	class routine final {
+	public:
+		struct promise_type;
+		using handle_t = std::coroutine_handle<promise_type>;
+
+		routine(routine&& other) noexcept;
+		routine& operator=(routine&& other) noexcept;
+		~routine();
+		ALC_NO_COPY(routine);
+
+		// returns true if the routine has not been started or awaited yet
+		bool is_valid() const;
+
+		// runs the routine inside of the awaiting one and resumes it once the routine finishes
+		auto operator co_await() && noexcept;
+
+		struct promise_type final {
+			std::coroutine_handle<> continuation;
+			behavior* owner = nullptr;
+
+			routine get_return_object() noexcept;
+			std::suspend_always initial_suspend() noexcept;
+			auto final_suspend() noexcept;
+			void return_void() noexcept;
+			void unhandled_exception() noexcept;
+		};
+
+		// gives up ownership of the coroutine
+		handle_t __release();
+
+	private:
+		handle_t m_handle;
+		explicit routine(handle_t handle);
+	};
+
+	// resumes the routine after the delay in seconds
+	struct wait_seconds final {
+		ALC_NO_COPY(wait_seconds);
+		ALC_NO_MOVE(wait_seconds);
+
+		explicit wait_seconds(double seconds);
+		~wait_seconds();
+
+		bool await_ready() const noexcept;
+		void await_suspend(routine::handle_t handle);
+		void await_resume() const noexcept;
+
+	private:
+		double m_seconds;
+		timer_handle m_timer;
+	};
+
+	// resumes the routine after count engine updates
+	struct wait_frames final {
+		ALC_NO_COPY(wait_frames);
+		ALC_NO_MOVE(wait_frames);
+
+		explicit wait_frames(uint64 count = 1);
+		~wait_frames();
+
+		bool await_ready() const noexcept;
+		void await_suspend(routine::handle_t handle);
+		void await_resume() const noexcept;
+
+	private:
+		uint64 m_count;
+		timer_handle m_timer;
+	};
+
+	// resumes the routine when the next deferred event of type Ty is dispatched (see alice_events::post)
+	// events the filter returns false for are skipped, the event is returned by co_await
+	template<typename Ty>
+	struct wait_until final {
+		ALC_NO_COPY(wait_until);
+		ALC_NO_MOVE(wait_until);
+
+		explicit wait_until(const function<bool, const Ty&>& filter = nullptr);
+		~wait_until();
+
+		bool await_ready() const noexcept;
+		void await_suspend(routine::handle_t handle);
+		Ty await_resume();
+
+	private:
+		function<bool, const Ty&> m_filter;
+		event_token m_token;
+		std::optional<Ty> m_event;
+	};
+
+
+	// implementations
+
+	inline routine::routine(handle_t handle) : m_handle(handle) { }
+
+	inline routine::routine(routine&& other) noexcept : m_handle(other.m_handle) {
+		other.m_handle = nullptr;
+	}
+
+	inline routine& routine::operator=(routine&& other) noexcept {
+		if (this != &other) {
+			if (m_handle) m_handle.destroy();
+			m_handle = other.m_handle;
+			other.m_handle = nullptr;
+		}
+		return *this;
+	}
+
+	inline routine::~routine() {
+		// never started, nothing else owns the frame
+		if (m_handle) m_handle.destroy();
+	}
+
+	inline bool routine::is_valid() const {
+		return m_handle != nullptr;
+	}
+
+	inline routine::handle_t routine::__release() {
+		handle_t handle = m_handle;
+		m_handle = nullptr;
+		return handle;
+	}
+
+	inline auto routine::operator co_await() && noexcept {
+		// the awaiter lives in the awaiting frame and owns the inner one,
+		// destroying the outer routine while the inner one waits destroys both
+		struct awaiter final {
+			handle_t handle;
+			awaiter(handle_t handle_) : handle(handle_) { }
+			awaiter(const awaiter&) = delete;
+			~awaiter() { if (handle) handle.destroy(); }
+			bool await_ready() const noexcept { return !handle; }
+			std::coroutine_handle<> await_suspend(handle_t awaiting) noexcept {
+				handle.promise().continuation = awaiting;
+				handle.promise().owner = awaiting.promise().owner;
+				return handle;
+			}
+			void await_resume() const noexcept { }
+		};
+		return awaiter{ __release() };
+	}
+
+	inline routine routine::promise_type::get_return_object() noexcept {
+		return routine(handle_t::from_promise(*this));
+	}
+
+	inline std::suspend_always routine::promise_type::initial_suspend() noexcept {
+		return { };
+	}
+
+	inline auto routine::promise_type::final_suspend() noexcept {
+		struct final_awaiter final {
+			bool await_ready() const noexcept { return false; }
+			std::coroutine_handle<> await_suspend(handle_t handle) noexcept {
+				// the awaiting routine destroys the frame once it continues
+				if (std::coroutine_handle<> continuation = handle.promise().continuation) return continuation;
+
+				// started by a behavior, nothing else owns the frame
+				if (behavior* owner = handle.promise().owner) detail::remove_routine(owner, handle.address());
+				handle.destroy();
+				return std::noop_coroutine();
+			}
+			void await_resume() const noexcept { }
+		};
+		return final_awaiter{ };
+	}
+
+	inline void routine::promise_type::return_void() noexcept { }
+
+	inline void routine::promise_type::unhandled_exception() noexcept {
+		std::terminate();
+	}
+
+	inline wait_seconds::wait_seconds(double seconds) : m_seconds(seconds), m_timer() { }
+
+	inline wait_seconds::~wait_seconds() {
+		timers::cancel(m_timer);
+	}
+
+	inline bool wait_seconds::await_ready() const noexcept {
+		return m_seconds <= 0.0;
+	}
+
+	inline void wait_seconds::await_suspend(routine::handle_t handle) {
+		behavior* owner = handle.promise().owner;
+		m_timer = timers::after(m_seconds, [owner, handle] { detail::resume_routine(owner, handle); }, owner);
+	}
+
+	inline void wait_seconds::await_resume() const noexcept { }
+
+	inline wait_frames::wait_frames(uint64 count) : m_count(count), m_timer() { }
+
+	inline wait_frames::~wait_frames() {
+		timers::cancel(m_timer);
+	}
+
+	inline bool wait_frames::await_ready() const noexcept {
+		return m_count == 0;
+	}
+
+	inline void wait_frames::await_suspend(routine::handle_t handle) {
+		behavior* owner = handle.promise().owner;
+		m_timer = timers::after_updates(m_count, [owner, handle] { detail::resume_routine(owner, handle); }, owner);
+	}
+
+	inline void wait_frames::await_resume() const noexcept { }
+
+	template<typename Ty>
+	inline wait_until<Ty>::wait_until(const function<bool, const Ty&>& filter) : m_filter(filter), m_token() { }
+
+	template<typename Ty>
+	inline wait_until<Ty>::~wait_until() {
+		if (m_token.is_valid()) alice_events::unsubscribe<Ty>(m_token);
+	}
+
+	template<typename Ty>
+	inline bool wait_until<Ty>::await_ready() const noexcept {
+		return false;
+	}
+
+	template<typename Ty>
+	inline void wait_until<Ty>::await_suspend(routine::handle_t handle) {
+		behavior* owner = handle.promise().owner;
+		m_token = alice_events::subscribe<Ty>([this, owner, handle](const Ty& ev) {
+			if (m_event || (m_filter && !m_filter(ev))) return;
+			m_event.emplace(ev);
+			// this can be destroyed once resumed, so stop listening first
+			alice_events::unsubscribe<Ty>(m_token);
+			detail::resume_routine(owner, handle);
+		});
+	}
+
+	template<typename Ty>
+	inline Ty wait_until<Ty>::await_resume() {
+		return std::move(*m_event);
+	}
+
+}
+
+#endif // !ALC_ENTITIES_ROUTINE_HPP
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "spatial_index.hpp"
+#include "entity_factory.hpp"
+#include "../jobs/job_system.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace alc {
+
+	namespace {
+
+		// distance along the ray to where it enters the sphere, negative if it misses
+		float ray_sphere(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& center, float radius) {
+			const glm::vec3 offset = origin - center;
+			const float b = glm::dot(offset, direction);
+			const float c = glm::dot(offset, offset) - radius * radius;
+			if (c <= 0.0f) return 0.0f; // starts inside
+			if (b > 0.0f) return -1.0f;
+			const float discriminant = b * b - c;
+			if (discriminant < 0.0f) return -1.0f;
+			return -b - std::sqrt(discriminant);
+		}
+
+		// queries are small so a sorted vector is faster than a heap
+		struct nearest_list final {
+			size_t count;
+			std::vector<std::pair<float, uint32>> best;
+
+			// returns the squared radius that is still worth searching
+			float add(float distance, uint32 id) {
+				if (best.size() == count && distance >= best.back().first) return radius2();
+				auto it = std::upper_bound(best.begin(), best.end(), std::make_pair(distance, id));
+				best.insert(it, std::make_pair(distance, id));
+				if (best.size() > count) best.pop_back();
+				return radius2();
+			}
+
+			float radius2() const {
+				if (best.size() < count) return std::numeric_limits<float>::infinity();
+				return best.back().first * best.back().first;
+			}
+		};
+
+	}
+
+	spatial_index::spatial_index(entity_factory* factory, spatial_structure structure, float size)
+		: m_factory(factory), m_structure(structure), m_grid(size), m_tree(size), m_size(0), m_version(factory->advance_version()) {
+		m_factory->__add_spatial_index(this);
+	}
+
+	spatial_index::~spatial_index() {
+		m_factory->__remove_spatial_index(this);
+	}
+
+	bool spatial_index::insert(entity* e, float radius) {
+		if (e == nullptr || e->get_factory() != m_factory) return false;
+		const uint64 key = e->get_handle().value();
+		if (m_ids.find(key) != m_ids.end()) return false;
+
+		// reuse ids so the structures stay small
+		uint32 id;
+		if (m_freeIds.size() > 0) {
+			id = m_freeIds.back();
+			m_freeIds.pop_back();
+		} else {
+			id = static_cast<uint32>(m_entries.size());
+			m_entries.emplace_back();
+		}
+
+		const glm::vec3 position = e->get_position();
+		m_entries[id] = entry{ e->get_handle(), position, radius, true };
+		m_ids.emplace(key, id);
+		if (m_structure == spatial_structure::hash_grid) m_grid.insert(id, aabb::from_sphere(position, radius));
+		else m_tree.insert(id, aabb::from_sphere(position, radius));
+		++m_size;
+		return true;
+	}
+
+	bool spatial_index::remove(entity* e) {
+		if (e == nullptr) return false;
+		auto it = m_ids.find(e->get_handle().value());
+		if (it == m_ids.end()) return false;
+		remove_id(it->second);
+		return true;
+	}
+
+	bool spatial_index::contains(const entity* e) const {
+		return e && m_ids.find(e->get_handle().value()) != m_ids.end();
+	}
+
+	size_t spatial_index::query_box(const aabb& box, std::vector<entity*>* out) const {
+		const size_t start = out->size();
+		query(box, [&](uint32 id) {
+			const entry& en = m_entries[id];
+			if (box.distance2(en.position) > en.radius * en.radius) return;
+			if (entity* e = get_entity(id)) out->push_back(e);
+		});
+		return out->size() - start;
+	}
+
+	size_t spatial_index::query_sphere(const glm::vec3& center, float radius, std::vector<entity*>* out) const {
+		const size_t start = out->size();
+		query(aabb::from_sphere(center, radius), [&](uint32 id) {
+			const entry& en = m_entries[id];
+			const glm::vec3 offset = en.position - center;
+			const float reach = radius + en.radius;
+			if (glm::dot(offset, offset) > reach * reach) return;
+			if (entity* e = get_entity(id)) out->push_back(e);
+		});
+		return out->size() - start;
+	}
+
+	entity* spatial_index::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance) const {
+		entity* closest = nullptr;
+		float closestDistance = maxDistance;
+		raycast(origin, direction, maxDistance, [&](uint32 id) {
+			const entry& en = m_entries[id];
+			const float t = ray_sphere(origin, direction, en.position, en.radius);
+			if (t >= 0.0f && t <= closestDistance) {
+				if (entity* e = get_entity(id)) {
+					closest = e;
+					closestDistance = t;
+				}
+			}
+			return closestDistance;
+		});
+		if (closest && distance) *distance = closestDistance;
+		return closest;
+	}
+
+	size_t spatial_index::query_nearest(const glm::vec3& point, size_t count, std::vector<entity*>* out) const {
+		if (count == 0) return 0;
+		nearest_list list{ count, { } };
+		list.best.reserve(count + 1);
+		nearest(point, [&](uint32 id) {
+			const entry& en = m_entries[id];
+			const float distance = std::max(0.0f, glm::length(en.position - point) - en.radius);
+			if (get_entity(id) == nullptr) return list.radius2();
+			return list.add(distance, id);
+		});
+
+		for (auto& [distance, id] : list.best) out->push_back(get_entity(id));
+		return list.best.size();
+	}
+
+	void spatial_index::query_boxes(const aabb* boxes, size_t count, std::vector<entity*>* results) const {
+		job_system::parallel_for(count, 16, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) query_box(boxes[i], &results[i]);
+		});
+	}
+
+	void spatial_index::query_spheres(const glm::vec3* centers, const float* radii, size_t count, std::vector<entity*>* results) const {
+		job_system::parallel_for(count, 16, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) query_sphere(centers[i], radii[i], &results[i]);
+		});
+	}
+
+	void spatial_index::raycasts(const glm::vec3* origins, const glm::vec3* directions, float maxDistance, size_t count, entity** results) const {
+		job_system::parallel_for(count, 16, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) results[i] = raycast(origins[i], directions[i], maxDistance);
+		});
+	}
+
+	void spatial_index::query_nearest(const glm::vec3* points, size_t count, size_t nearestCount, std::vector<entity*>* results) const {
+		job_system::parallel_for(count, 16, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) query_nearest(points[i], nearestCount, &results[i]);
+		});
+	}
+
+	void spatial_index::__update() {
+		// transforms that moved this update are stamped after the last version this index took
+		const uint32 version = m_factory->advance_version();
+		m_factory->each_moved(m_version, [this](entity* e) {
+			auto it = m_ids.find(e->get_handle().value());
+			if (it == m_ids.end()) return;
+
+			// rotating or scaling also stamps the transform
+			entry& en = m_entries[it->second];
+			const glm::vec3 position = e->get_position();
+			if (position == en.position) return;
+			en.position = position;
+			if (m_structure == spatial_structure::hash_grid) m_grid.update(it->second, aabb::from_sphere(position, en.radius));
+			else m_tree.update(it->second, aabb::from_sphere(position, en.radius));
+		});
+		m_version = version;
+	}
+
+	void spatial_index::remove_id(uint32 id) {
+		entry& en = m_entries[id];
+		m_ids.erase(en.handle.value());
+		if (m_structure == spatial_structure::hash_grid) m_grid.remove(id);
+		else m_tree.remove(id);
+		en.used = false;
+		m_freeIds.push_back(id);
+		--m_size;
+	}
+
+	entity* spatial_index::get_entity(uint32 id) const {
+		return m_factory->get(m_entries[id].handle);
+	}
+
+}
\ No newline at end of file
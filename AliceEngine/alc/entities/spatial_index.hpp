@@ -0,0 +1,144 @@
+#ifndef ALC_ENTITIES_SPATIAL_INDEX_HPP
+#define ALC_ENTITIES_SPATIAL_INDEX_HPP
+#include "../common.hpp"
+#include "../datatypes/aabb.hpp"
+#include "../datatypes/aabb_tree.hpp"
+#include "../datatypes/hash_grid.hpp"
+#include "entity_handle.hpp"
+#include <unordered_map>
+
+namespace alc {
+
+	class entity;
+	class entity_factory;
+
+	// the structure a spatial_index stores its entities in
+	enum class spatial_structure : uint8 {
+		// uniform grid, best for many entities of similar size spread over a big area
+		hash_grid,
+		// bounding volume hierarchy, best for clustered entities or very different sizes
+		bvh
+	};
+
+	// finds entities by their world position
+	// each entity is a sphere around its position, only entities that were inserted are found
+	// the factory updates every index after its transforms, moved entities are found through the transform versions
+	// so entities that did not move are never visited, each update advances the factory's version
+	// destroyed entities are removed as they are destroyed
+	// queries only read and can be called from any number of job threads at once, but not while the
+	// factory is updating
+	// must be destroyed before its factory
+	//     spatial_index index(factory, spatial_structure::hash_grid, 4.0f);
+	//     index.insert(enemy, 0.5f);
+	//     index.query_sphere(get_position(), 10.0f, &visible);
+	class spatial_index final {
+		ALC_NO_COPY(spatial_index);
+		ALC_NO_MOVE(spatial_index);
+	public:
+
+		// size is the cell size of a hash_grid or the margin of a bvh
+		spatial_index(entity_factory* factory, spatial_structure structure = spatial_structure::bvh, float size = 4.0f);
+		~spatial_index();
+
+		// adds the entity as a sphere of the radius
+		// returns false if it was null or is already in the index
+		bool insert(entity* e, float radius = 0.0f);
+
+		// removes the entity
+		// returns false if it was not in the index
+		bool remove(entity* e);
+
+		// returns true if the entity is in the index
+		bool contains(const entity* e) const;
+
+		// returns the number of entities in the index
+		size_t size() const;
+
+		// returns the structure the entities are stored in
+		spatial_structure get_structure() const;
+
+		// finds the entities that overlap the box
+		// returns the number of entities added to out
+		size_t query_box(const aabb& box, std::vector<entity*>* out) const;
+
+		// finds the entities that overlap the sphere
+		// returns the number of entities added to out
+		size_t query_sphere(const glm::vec3& center, float radius, std::vector<entity*>* out) const;
+
+		// finds the closest entity along the ray, direction must be normalized
+		// returns null if nothing was hit
+		entity* raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance = nullptr) const;
+
+		// finds up to count entities closest to the point, sorted from closest
+		// returns the number of entities added to out
+		size_t query_nearest(const glm::vec3& point, size_t count, std::vector<entity*>* out) const;
+
+		// batched versions, the queries are spread across the job system
+		// results must hold one vector per query
+		void query_boxes(const aabb* boxes, size_t count, std::vector<entity*>* results) const;
+		void query_spheres(const glm::vec3* centers, const float* radii, size_t count, std::vector<entity*>* results) const;
+		void raycasts(const glm::vec3* origins, const glm::vec3* directions, float maxDistance, size_t count, entity** results) const;
+		void query_nearest(const glm::vec3* points, size_t count, size_t nearestCount, std::vector<entity*>* results) const;
+
+		// moves entities whose transform changed since the last update
+		void __update();
+
+	private:
+		struct entry final {
+			entity_handle handle;
+			glm::vec3 position;
+			float radius;
+			bool used;
+		};
+
+		entity_factory* m_factory;
+		spatial_structure m_structure;
+		hash_grid m_grid;
+		aabb_tree m_tree;
+		std::vector<entry> m_entries; // indexed by id
+		std::vector<uint32> m_freeIds;
+		std::unordered_map<uint64, uint32> m_ids; // handle value to id
+		size_t m_size;
+		uint32 m_version; // transforms stamped after this moved since the last update
+
+		void remove_id(uint32 id);
+		entity* get_entity(uint32 id) const;
+
+		// runs the query on whichever structure is used
+		template<typename Fn> void query(const aabb& box, Fn&& fn) const;
+		template<typename Fn> void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Fn&& fn) const;
+		template<typename Fn> void nearest(const glm::vec3& point, Fn&& fn) const;
+	};
+
+
+	// implementations
+
+	inline size_t spatial_index::size() const {
+		return m_size;
+	}
+
+	inline spatial_structure spatial_index::get_structure() const {
+		return m_structure;
+	}
+
+	template<typename Fn>
+	inline void spatial_index::query(const aabb& box, Fn&& fn) const {
+		if (m_structure == spatial_structure::hash_grid) m_grid.query(box, fn);
+		else m_tree.query(box, fn);
+	}
+
+	template<typename Fn>
+	inline void spatial_index::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Fn&& fn) const {
+		if (m_structure == spatial_structure::hash_grid) m_grid.raycast(origin, direction, maxDistance, fn);
+		else m_tree.raycast(origin, direction, maxDistance, fn);
+	}
+
+	template<typename Fn>
+	inline void spatial_index::nearest(const glm::vec3& point, Fn&& fn) const {
+		if (m_structure == spatial_structure::hash_grid) m_grid.nearest(point, fn);
+		else m_tree.nearest(point, fn);
+	}
+
+}
+
+#endif // !ALC_ENTITIES_SPATIAL_INDEX_HPP
\ No newline at end of file
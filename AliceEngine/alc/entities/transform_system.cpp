@@ -0,0 +1,221 @@
+#include "transform_system.hpp"
+#include "entity_factory.hpp"
+#include "../core/profiler.hpp"
+#include "../jobs/job_system.hpp"
+#include <glm\gtc\matrix_transform.hpp>
+#include <algorithm>
+
+namespace alc {
+
+	transform_system::transform_system(size_t reserve_) : m_orderDirty(false), m_destroyed(0), m_anyDirty(false) {
+		reserve(reserve_);
+	}
+
+	void transform_system::reserve(size_t count) {
+		const size_t capacity = m_owners.size() + count;
+		m_positions.reserve(capacity);
+		m_rotations.reserve(capacity);
+		m_scales.reserve(capacity);
+		m_worlds.reserve(capacity);
+		m_parents.reserve(capacity);
+		m_subtreeEnds.reserve(capacity);
+		m_dirty.reserve(capacity);
+		m_versions.reserve(capacity);
+		m_subtreeVersions.reserve(capacity);
+		m_owners.reserve(capacity);
+	}
+
+	uint32 transform_system::create(entity* owner) {
+		const uint32 index = static_cast<uint32>(m_owners.size());
+		m_positions.emplace_back(0.0f);
+		m_rotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+		m_scales.emplace_back(1.0f);
+		m_worlds.emplace_back(1.0f);
+		m_parents.push_back(npos);
+		m_subtreeEnds.push_back(index + 1);
+		m_dirty.push_back(0);
+		m_versions.push_back(0);
+		m_subtreeVersions.push_back(0);
+		m_owners.push_back(owner);
+
+		// a new root at the end keeps the order valid
+		if (!m_orderDirty) m_roots.push_back(index);
+		return index;
+	}
+
+	void transform_system::destroy(uint32 index) {
+		const bool leaf = m_subtreeEnds[index] == index + 1;
+		m_owners[index] = nullptr;
+
+		// transforms with children need the order rebuilt
+		if (m_orderDirty || !leaf) {
+			m_parents[index] = npos;
+			m_orderDirty = true;
+			return;
+		}
+
+		// leaves are left in place and skipped, the order is only compacted once enough have piled up
+		m_dirty[index] = 0;
+		m_versions[index] = 0;
+		if (m_parents[index] == npos) m_subtreeVersions[index] = 0;
+		if (++m_destroyed > min_compact && m_destroyed * 4 > m_owners.size()) m_orderDirty = true;
+	}
+
+	void transform_system::set_parent(uint32 index, uint32 parent) {
+		if (m_parents[index] == parent) return;
+		m_parents[index] = parent;
+		m_orderDirty = true;
+		mark_dirty(index);
+	}
+
+	void transform_system::set_position(uint32 index, const glm::vec3& position) {
+		m_positions[index] = position;
+		mark_dirty(index);
+	}
+
+	void transform_system::set_rotation(uint32 index, const glm::quat& rotation) {
+		m_rotations[index] = rotation;
+		mark_dirty(index);
+	}
+
+	void transform_system::set_scale(uint32 index, const glm::vec3& scale) {
+		m_scales[index] = scale;
+		mark_dirty(index);
+	}
+
+	glm::mat4 transform_system::get_local_matrix(uint32 index) const {
+		const glm::mat4 translated = glm::translate(glm::mat4(1.0f), m_positions[index]);
+		return glm::scale(translated * glm::mat4_cast(m_rotations[index]), m_scales[index]);
+	}
+
+	glm::mat4 transform_system::get_world_matrix(uint32 index) const {
+		// while the order is invalid a clean transform can still have a dirty parent
+		if (!m_orderDirty && !m_dirty[index]) return m_worlds[index];
+
+		const uint32 parent = m_parents[index];
+		if (parent == npos) return get_local_matrix(index);
+		return get_world_matrix(parent) * get_local_matrix(index);
+	}
+
+	void transform_system::update(uint32 version) {
+		ALC_PROFILE_SCOPE("transform_system::update");
+		if (m_orderDirty) rebuild();
+		if (!m_anyDirty.exchange(false, std::memory_order_relaxed)) return;
+
+		// hierarchies dont depend on each other so they can be updated at the same time
+		job_system::parallel_for(m_roots.size(), 64, [this, version](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				const uint32 root = m_roots[i];
+				update_range(root, m_subtreeEnds[root], version);
+			}
+		});
+	}
+
+	void transform_system::mark_dirty(uint32 index) {
+		m_anyDirty.store(true, std::memory_order_relaxed);
+
+		// without a valid order the subtree is marked when rebuilding
+		if (m_orderDirty) {
+			m_dirty[index] = 1;
+			return;
+		}
+
+		// a dirty transform always has a dirty subtree
+		if (m_dirty[index]) return;
+		std::fill(m_dirty.begin() + index, m_dirty.begin() + m_subtreeEnds[index], uint8(1));
+	}
+
+	void transform_system::rebuild() {
+		const uint32 count = static_cast<uint32>(m_owners.size());
+
+		// count the children of every transform, transforms with a destroyed parent become roots
+		m_childStarts.assign(count + 1, 0);
+		for (uint32 i = 0; i < count; i++) {
+			const uint32 parent = m_parents[i];
+			if (m_owners[i] == nullptr || parent == npos) continue;
+			if (m_owners[parent] == nullptr) m_parents[i] = npos;
+			else m_childStarts[parent + 1]++;
+		}
+		for (uint32 i = 0; i < count; i++) m_childStarts[i + 1] += m_childStarts[i];
+
+		// list the children of every transform contiguously
+		m_children.resize(m_childStarts[count]);
+		m_remap.assign(m_childStarts.begin(), m_childStarts.end() - 1);
+		for (uint32 i = 0; i < count; i++) {
+			const uint32 parent = m_parents[i];
+			if (m_owners[i] && parent != npos) m_children[m_remap[parent]++] = i;
+		}
+
+		// depth first so every subtree is contiguous, destroyed transforms are left out
+		m_order.clear();
+		std::vector<uint32> stack;
+		for (uint32 i = 0; i < count; i++) {
+			if (m_owners[i] == nullptr || m_parents[i] != npos) continue;
+			stack.push_back(i);
+			while (stack.size() > 0) {
+				const uint32 top = stack.back();
+				stack.pop_back();
+				m_order.push_back(top);
+				for (uint32 c = m_childStarts[top + 1]; c > m_childStarts[top]; c--) {
+					stack.push_back(m_children[c - 1]);
+				}
+			}
+		}
+
+		// move everything to its new index
+		m_remap.assign(count, npos);
+		for (uint32 i = 0; i < m_order.size(); i++) m_remap[m_order[i]] = i;
+		for (uint32& parent : m_parents) {
+			if (parent != npos) parent = m_remap[parent];
+		}
+		permute(m_positions);
+		permute(m_rotations);
+		permute(m_scales);
+		permute(m_worlds);
+		permute(m_parents);
+		permute(m_dirty);
+		permute(m_versions);
+		permute(m_subtreeVersions);
+		permute(m_owners);
+
+		// children come after their parent so walking backwards finds the end of every subtree
+		const uint32 size = static_cast<uint32>(m_order.size());
+		m_subtreeEnds.resize(size);
+		m_destroyed = 0;
+		for (uint32 i = 0; i < size; i++) m_subtreeEnds[i] = i + 1;
+		for (uint32 i = size; i > 0; i--) {
+			const uint32 parent = m_parents[i - 1];
+			if (parent != npos) m_subtreeEnds[parent] = std::max(m_subtreeEnds[parent], m_subtreeEnds[i - 1]);
+		}
+
+		// spread dirty flags down and tell the entities where their transform went
+		m_roots.clear();
+		for (uint32 i = 0; i < size; i++) {
+			const uint32 parent = m_parents[i];
+			if (parent == npos) m_roots.push_back(i);
+			else if (m_dirty[parent]) m_dirty[i] = 1;
+			m_owners[i]->__set_transform_index(i);
+		}
+
+		// hierarchies could have been joined or split so find the newest version of every root again
+		for (uint32 root : m_roots) {
+			m_subtreeVersions[root] = *std::max_element(m_versions.begin() + root, m_versions.begin() + m_subtreeEnds[root]);
+		}
+		m_orderDirty = false;
+	}
+
+	void transform_system::update_range(uint32 begin, uint32 end, uint32 version) {
+		bool changed = false;
+		for (uint32 i = begin; i < end; i++) {
+			if (!m_dirty[i]) continue;
+			const uint32 parent = m_parents[i];
+			if (parent == npos) m_worlds[i] = get_local_matrix(i);
+			else m_worlds[i] = m_worlds[parent] * get_local_matrix(i);
+			m_dirty[i] = 0;
+			m_versions[i] = version;
+			changed = true;
+		}
+		if (changed) m_subtreeVersions[begin] = version;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#ifndef ALC_ENTITIES_TRANSFORM_SYSTEM_HPP
+#define ALC_ENTITIES_TRANSFORM_SYSTEM_HPP
+#include "../common.hpp"
+#include <glm\gtc\quaternion.hpp>
+#include <atomic>
+
+namespace alc {
+
+	class entity;
+
+	// stores the transforms of a factory's entities
+	// position, rotation, scale and the cached world matrix are kept in separate contiguous arrays
+	// sorted so that every parent comes before its children and each subtree is a contiguous range
+	// writing a transform marks its subtree dirty, update recomputes only the dirty world matrices
+	// once per frame, with independent roots split across the job system
+	// indices change whenever the order is rebuilt, the owning entity is told its new index
+	// every transform stores the version its world matrix last changed in so changes can be found
+	// without walking hierarchies that did not move
+	// positions, rotations and scales of transforms in different hierarchies can be set from different threads,
+	// creating, destroying and parenting change the shared order and must happen on one thread while nothing
+	// else is using the system, the same goes for updating
+	class transform_system final {
+		ALC_NO_COPY(transform_system);
+		ALC_NO_MOVE(transform_system);
+	public:
+
+		static constexpr uint32 npos = static_cast<uint32>(-1);
+
+		transform_system(size_t reserve_ = 0);
+
+		// adds an identity transform without a parent and returns its index
+		// must not be called while other threads are setting transforms
+		uint32 create(entity* owner);
+
+		// removes the transform, it is dropped the next time the order is rebuilt
+		// the transform should not have any children left, destroying a transform without children
+		// only rebuilds the order once a quarter of the transforms are destroyed
+		// must not be called while other threads are setting transforms
+		void destroy(uint32 index);
+
+		// the parent of the transform, npos if it has none
+		// the relative transform is kept so the world transform changes
+		// must not be called while other threads are setting transforms
+		void set_parent(uint32 index, uint32 parent);
+
+		// the parent of the transform, npos if it has none
+		uint32 get_parent(uint32 index) const;
+
+		// the position relative to the parent
+		const glm::vec3& get_position(uint32 index) const;
+
+		// the position relative to the parent
+		void set_position(uint32 index, const glm::vec3& position);
+
+		// the rotation relative to the parent
+		const glm::quat& get_rotation(uint32 index) const;
+
+		// the rotation relative to the parent
+		void set_rotation(uint32 index, const glm::quat& rotation);
+
+		// the scale relative to the parent
+		const glm::vec3& get_scale(uint32 index) const;
+
+		// the scale relative to the parent
+		void set_scale(uint32 index, const glm::vec3& scale);
+
+		// returns the transform relative to the parent as a matrix
+		glm::mat4 get_local_matrix(uint32 index) const;
+
+		// returns the world matrix
+		// clean transforms return the cached matrix, dirty ones are computed up the chain without being stored
+		glm::mat4 get_world_matrix(uint32 index) const;
+
+		// returns the entity that owns the transform, null if it was destroyed
+		entity* get_owner(uint32 index) const;
+
+		// returns the version the world matrix last changed in
+		uint32 get_version(uint32 index) const;
+
+		// calls fn(index) for every transform whose world matrix changed after the version
+		// only valid after updating, before any hierarchy changes
+		template<typename Fn> void each_changed(uint32 since, Fn&& fn) const;
+
+		// returns the number of transforms, including destroyed ones that have not been dropped yet
+		size_t size() const;
+
+		// makes room for count more transforms without reallocating
+		void reserve(size_t count);
+
+		// rebuilds the order if the hierarchy changed and recomputes every dirty world matrix
+		// recomputed transforms are stamped with the version
+		void update(uint32 version = 0);
+
+	private:
+		// transform data, indexed by the transform's index
+		std::vector<glm::vec3> m_positions;
+		std::vector<glm::quat> m_rotations;
+		std::vector<glm::vec3> m_scales;
+		std::vector<glm::mat4> m_worlds;
+		std::vector<uint32> m_parents;
+		std::vector<uint32> m_subtreeEnds; // one past the last transform in the subtree
+		std::vector<uint8> m_dirty;
+		std::vector<uint32> m_versions;
+		std::vector<uint32> m_subtreeVersions; // the newest version in the subtree, kept for roots
+		std::vector<entity*> m_owners; // null once destroyed
+
+		// the first transform of every hierarchy
+		std::vector<uint32> m_roots;
+
+		// set when parents change or transforms are destroyed, subtree ranges are invalid until rebuilt
+		bool m_orderDirty;
+
+		// destroyed transforms still in the order, skipped until it is rebuilt
+		size_t m_destroyed;
+		static constexpr size_t min_compact = 64;
+
+		// set when any transform was written since the last update
+		std::atomic_bool m_anyDirty;
+
+		// kept to reuse memory when rebuilding
+		std::vector<uint32> m_order;
+		std::vector<uint32> m_remap;
+		std::vector<uint32> m_childStarts;
+		std::vector<uint32> m_children;
+
+		void mark_dirty(uint32 index);
+		void rebuild();
+		void update_range(uint32 begin, uint32 end, uint32 version);
+		template<typename Ty> void permute(std::vector<Ty>& values);
+	};
+
+
+	// implementations
+
+	inline uint32 transform_system::get_parent(uint32 index) const {
+		return m_parents[index];
+	}
+
+	inline const glm::vec3& transform_system::get_position(uint32 index) const {
+		return m_positions[index];
+	}
+
+	inline const glm::quat& transform_system::get_rotation(uint32 index) const {
+		return m_rotations[index];
+	}
+
+	inline const glm::vec3& transform_system::get_scale(uint32 index) const {
+		return m_scales[index];
+	}
+
+	inline entity* transform_system::get_owner(uint32 index) const {
+		return m_owners[index];
+	}
+
+	inline uint32 transform_system::get_version(uint32 index) const {
+		return m_versions[index];
+	}
+
+	template<typename Fn>
+	inline void transform_system::each_changed(uint32 since, Fn&& fn) const {
+		for (uint32 root : m_roots) {
+			if (m_subtreeVersions[root] <= since) continue;
+			for (uint32 i = root; i < m_subtreeEnds[root]; i++) {
+				if (m_versions[i] > since) fn(i);
+			}
+		}
+	}
+
+	inline size_t transform_system::size() const {
+		return m_owners.size();
+	}
+
+	template<typename Ty>
+	inline void transform_system::permute(std::vector<Ty>& values) {
+		std::vector<Ty> sorted;
+		sorted.reserve(m_order.size());
+		for (uint32 index : m_order) sorted.push_back(values[index]);
+		values.swap(sorted);
+	}
+
+}
+
+#endif // !ALC_ENTITIES_TRANSFORM_SYSTEM_HPP
\ No newline at end of file
@@ -0,0 +1,412 @@
+#include "job_system.hpp"
+#include "../core/debug.hpp"
+#include "../core/profiler.hpp"
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace alc {
+
+	namespace {
+
+		// Chase-Lev work stealing deque
+		// the owning worker pushes and pops at the bottom, other threads steal from the top
+		class job_deque final {
+		public:
+			static constexpr int64 capacity = 4096;
+			static constexpr int64 mask = capacity - 1;
+
+			// returns false if the deque is full
+			bool push(job* j) {
+				const int64 b = m_bottom.load(std::memory_order_relaxed);
+				const int64 t = m_top.load(std::memory_order_acquire);
+				if (b - t >= capacity) return false;
+				m_buffer[b & mask].store(j, std::memory_order_relaxed);
+				m_bottom.store(b + 1, std::memory_order_release);
+				return true;
+			}
+
+			// only called by the owner
+			job* pop() {
+				const int64 b = m_bottom.load(std::memory_order_relaxed) - 1;
+				m_bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64 t = m_top.load(std::memory_order_relaxed);
+
+				job* j = nullptr;
+				if (t <= b) {
+					j = m_buffer[b & mask].load(std::memory_order_relaxed);
+					// last job, race against thieves
+					if (t == b) {
+						if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+							j = nullptr;
+						m_bottom.store(b + 1, std::memory_order_relaxed);
+					}
+				} else {
+					m_bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return j;
+			}
+
+			// called by any thread
+			job* steal() {
+				int64 t = m_top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const int64 b = m_bottom.load(std::memory_order_acquire);
+				if (t >= b) return nullptr;
+
+				job* j = m_buffer[t & mask].load(std::memory_order_relaxed);
+				if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					return nullptr;
+				return j;
+			}
+
+			bool empty() const {
+				return m_bottom.load(std::memory_order_acquire) <= m_top.load(std::memory_order_acquire);
+			}
+
+		private:
+			alignas(64) std::atomic<int64> m_top = 0;
+			alignas(64) std::atomic<int64> m_bottom = 0;
+			std::atomic<job*> m_buffer[capacity] = { };
+		};
+
+		// number of jobs in each threads ring of jobs
+		constexpr size_t job_ring_size = 4096;
+
+		std::vector<std::unique_ptr<job_deque>> s_deques;
+		std::vector<std::thread> s_workers;
+		std::atomic_bool s_isRunning = false;
+		std::atomic_bool s_shouldQuit = false;
+
+		// jobs that were submitted and have not finished running
+		std::atomic_size_t s_pending = 0;
+
+		// threads that are not workers and are touching the queues, stop waits for them before freeing the queues
+		std::atomic_size_t s_external = 0;
+
+		// jobs submitted from threads that are not workers
+		std::mutex s_injectLock;
+		std::deque<job*> s_injected;
+		std::atomic_size_t s_injectedSize = 0;
+
+		// sleeping
+		std::mutex s_sleepLock;
+		std::condition_variable s_wake;
+		std::atomic_size_t s_sleeping = 0;
+		size_t s_wakeTokens = 0;
+
+		thread_local size_t t_workerIndex = static_cast<size_t>(-1);
+		thread_local std::unique_ptr<job[]> t_jobRing;
+		thread_local size_t t_jobRingIndex = 0;
+		thread_local uint32 t_random = 0;
+
+		uint32 next_random() {
+			// xorshift
+			uint32 x = t_random != 0 ? t_random : 2463534242u + static_cast<uint32>(t_workerIndex);
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			return t_random = x;
+		}
+
+		job* pop_injected() {
+			if (s_injectedSize.load(std::memory_order_acquire) == 0) return nullptr;
+			std::lock_guard<std::mutex> _(s_injectLock);
+			if (s_injected.size() == 0) return nullptr;
+			job* j = s_injected.front();
+			s_injected.pop_front();
+			s_injectedSize.fetch_sub(1, std::memory_order_release);
+			return j;
+		}
+
+		// finds a job for the thread, returns nullptr if there is none
+		job* find_job(size_t index) {
+			// our own queue first
+			if (index < s_deques.size()) {
+				if (job* j = s_deques[index]->pop()) return j;
+			}
+
+			// steal starting at a random worker
+			const size_t count = s_deques.size();
+			if (count > 0) {
+				const size_t start = next_random() % count;
+				for (size_t i = 0; i < count; i++) {
+					const size_t victim = (start + i) % count;
+					if (victim == index) continue;
+					if (job* j = s_deques[victim]->steal()) return j;
+				}
+			}
+
+			return pop_injected();
+		}
+
+		bool has_work() {
+			if (s_injectedSize.load() > 0) return true;
+			for (auto& deque : s_deques) {
+				if (!deque->empty()) return true;
+			}
+			return false;
+		}
+
+		void wake_one() {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (s_sleeping.load() == 0) return;
+			std::lock_guard<std::mutex> _(s_sleepLock);
+			if (s_sleeping.load() > s_wakeTokens) {
+				++s_wakeTokens;
+				s_wake.notify_one();
+			}
+		}
+
+	}
+
+	void job_system::start(uint32 threadCount) {
+		if (s_isRunning) {
+			ALC_DEBUG_WARNING("Could not start job_system since it was already running");
+			return;
+		}
+
+		if (threadCount == 0) {
+			threadCount = std::thread::hardware_concurrency();
+			threadCount = threadCount > 1 ? threadCount - 1 : 1;
+		}
+
+		s_shouldQuit = false;
+		s_wakeTokens = 0;
+
+		// this thread is worker 0
+		s_deques.resize(static_cast<size_t>(threadCount) + 1);
+		for (auto& deque : s_deques) deque = std::make_unique<job_deque>();
+		t_workerIndex = 0;
+		s_isRunning = true;
+
+		for (uint32 i = 1; i <= threadCount; i++) {
+			s_workers.emplace_back([](size_t index) {
+				t_workerIndex = index;
+				size_t idleSpins = 0;
+				while (!s_shouldQuit.load(std::memory_order_acquire)) {
+					if (job* j = find_job(index)) {
+						execute(j);
+						idleSpins = 0;
+						continue;
+					}
+
+					// spin for a little before going to sleep
+					if (++idleSpins < 64) {
+						std::this_thread::yield();
+						continue;
+					}
+
+					std::unique_lock<std::mutex> lock(s_sleepLock);
+					s_sleeping.fetch_add(1);
+					// check again now that submitters can see that we are sleeping
+					if (!has_work() && !s_shouldQuit) {
+						s_wake.wait(lock, [] { return s_wakeTokens > 0 || s_shouldQuit; });
+						if (s_wakeTokens > 0) --s_wakeTokens;
+					}
+					s_sleeping.fetch_sub(1);
+					idleSpins = 0;
+				}
+			}, static_cast<size_t>(i));
+		}
+	}
+
+	void job_system::stop() {
+		if (!s_isRunning) return;
+
+		// runs jobs until every submitted job has finished, including jobs submitted while draining
+		auto drain = []() {
+			while (s_pending.load(std::memory_order_acquire) > 0) {
+				if (job* j = find_job(t_workerIndex)) execute(j);
+				else std::this_thread::yield();
+			}
+		};
+
+		// finish anything left over
+		drain();
+
+		// new jobs run where they are submitted from now on,
+		// then finish whatever was submitted before the submitter saw that
+		s_isRunning.store(false, std::memory_order_seq_cst);
+		drain();
+
+		{
+			std::lock_guard<std::mutex> _(s_sleepLock);
+			s_shouldQuit = true;
+		}
+		s_wake.notify_all();
+		for (auto& worker : s_workers) worker.join();
+		s_workers.clear();
+
+		// other threads could still be looking at the queues
+		while (s_external.load(std::memory_order_seq_cst) > 0) std::this_thread::yield();
+		s_deques.clear();
+		t_workerIndex = static_cast<size_t>(-1);
+	}
+
+	bool job_system::is_running() {
+		return s_isRunning.load(std::memory_order_acquire);
+	}
+
+	size_t job_system::get_worker_count() {
+		return s_deques.size();
+	}
+
+	size_t job_system::get_worker_index() {
+		return t_workerIndex;
+	}
+
+	bool job_system::is_main_thread() {
+		return !is_running() || t_workerIndex == 0;
+	}
+
+	void job_system::wait(job_counter* counter) {
+		if (counter == nullptr) return;
+		while (!counter->is_done()) {
+			// help instead of blocking
+			job* j = nullptr;
+			if (t_workerIndex != static_cast<size_t>(-1)) j = find_job(t_workerIndex);
+			else {
+				s_external.fetch_add(1, std::memory_order_seq_cst);
+				if (s_isRunning.load(std::memory_order_seq_cst)) j = find_job(t_workerIndex);
+				s_external.fetch_sub(1, std::memory_order_release);
+			}
+			if (j) execute(j);
+			else std::this_thread::yield();
+		}
+	}
+
+	job* job_system::allocate_job() {
+		if (!t_jobRing) t_jobRing.reset(new job[job_ring_size]);
+
+		// reuse the next job in the ring if it has finished
+		job* j = &t_jobRing[t_jobRingIndex++ % job_ring_size];
+		if (j->m_func.load(std::memory_order_acquire) == nullptr) {
+			j->m_isHeap = false;
+			return j;
+		}
+
+		// every job in the ring is still in flight
+		j = new job();
+		j->m_isHeap = true;
+		return j;
+	}
+
+	void job_system::submit_job(job* j) {
+		const size_t index = t_workerIndex;
+		s_pending.fetch_add(1, std::memory_order_relaxed);
+
+		// workers own their queue
+		if (index != static_cast<size_t>(-1)) {
+			if (!s_deques[index]->push(j)) {
+				// the queue is full
+				std::lock_guard<std::mutex> _(s_injectLock);
+				s_injected.push_back(j);
+				s_injectedSize.fetch_add(1, std::memory_order_release);
+			}
+			wake_one();
+			return;
+		}
+
+		// the job system could have been stopped since the caller checked
+		s_external.fetch_add(1, std::memory_order_seq_cst);
+		if (!s_isRunning.load(std::memory_order_seq_cst)) {
+			s_external.fetch_sub(1, std::memory_order_release);
+			execute(j);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> _(s_injectLock);
+			s_injected.push_back(j);
+			s_injectedSize.fetch_add(1, std::memory_order_release);
+		}
+		wake_one();
+		s_external.fetch_sub(1, std::memory_order_release);
+	}
+
+	void job_system::execute(job* j) {
+		job::job_fn func = j->m_func.load(std::memory_order_relaxed);
+		job_counter* counter = j->m_counter;
+		{
+			ALC_PROFILE_SCOPE("job");
+			func(j);
+		}
+		s_pending.fetch_sub(1, std::memory_order_acq_rel);
+
+		// release the job before the counter so waiters can reuse it
+		if (j->m_isHeap) delete j;
+		else j->m_func.store(nullptr, std::memory_order_release);
+
+		if (counter) __release(counter);
+	}
+
+	bool job_system::__add_waiter(job_counter* counter, detail::job_waiter* waiter) {
+		// lock the waiter list, unless the counter is already done
+		uint32 value = counter->m_value.load(std::memory_order_acquire);
+		while (true) {
+			if (value == 0) return false;
+			if (value & job_counter::lock_bit) {
+				std::this_thread::yield();
+				value = counter->m_value.load(std::memory_order_acquire);
+				continue;
+			}
+			if (counter->m_value.compare_exchange_weak(value, value | job_counter::lock_bit, std::memory_order_acquire))
+				break;
+		}
+
+		waiter->next = counter->m_waiters;
+		counter->m_waiters = waiter;
+
+		// unlock, the last job may have finished while the list was locked
+		value = counter->m_value.load(std::memory_order_acquire);
+		while (true) {
+			if (value == job_counter::lock_bit) {
+				// we are the head of the list, dont suspend and resume everyone else
+				detail::job_waiter* others = waiter->next;
+				counter->m_waiters = nullptr;
+				counter->m_value.store(0, std::memory_order_release);
+				resume_waiters(others);
+				return false;
+			}
+			if (counter->m_value.compare_exchange_weak(value, value & ~job_counter::lock_bit, std::memory_order_acq_rel))
+				return true;
+		}
+	}
+
+	void job_system::__resume(void* coroutine) {
+		submit([coroutine]() { std::coroutine_handle<>::from_address(coroutine).resume(); });
+	}
+
+	void job_system::__release(job_counter* counter) {
+		uint32 value = counter->m_value.load(std::memory_order_relaxed);
+		while (true) {
+			if (value == 1) {
+				// last job, lock the list and take the waiting coroutines
+				// the counter must not be touched once the value is zero
+				if (counter->m_value.compare_exchange_weak(value, job_counter::lock_bit, std::memory_order_acq_rel)) {
+					detail::job_waiter* waiters = counter->m_waiters;
+					counter->m_waiters = nullptr;
+					counter->m_value.store(0, std::memory_order_release);
+					resume_waiters(waiters);
+					return;
+				}
+				continue;
+			}
+			if (counter->m_value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel))
+				return;
+		}
+	}
+
+	void job_system::resume_waiters(detail::job_waiter* waiter) {
+		while (waiter) {
+			// the waiter lives in the coroutine frame, read next before the coroutine can resume
+			detail::job_waiter* next = waiter->next;
+			__resume(waiter->coroutine);
+			waiter = next;
+		}
+	}
+
+}
@@ -0,0 +1,185 @@
+#ifndef ALC_JOBS_JOB_SYSTEM_HPP
+#define ALC_JOBS_JOB_SYSTEM_HPP
+#include "../common.hpp"
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace alc {
+
+	class job_system;
+
+	namespace detail {
+		// a suspended coroutine waiting on a job_counter, lives inside of the coroutine frame
+		struct job_waiter final {
+			void* coroutine = nullptr;
+			job_waiter* next = nullptr;
+		};
+	}
+
+	// counts unfinished jobs
+	// incremented when a job is submitted with it and decremented when that job finishes
+	// use job_system::wait to wait for it to reach zero, or co_await it from a job_task
+	struct job_counter final {
+		ALC_NO_COPY(job_counter);
+		ALC_NO_MOVE(job_counter);
+
+		job_counter() = default;
+
+		// returns the number of unfinished jobs
+		uint32 get() const;
+
+		// returns true once every job has finished
+		bool is_done() const;
+
+	private:
+		friend job_system;
+		// the top bit locks the waiter list, the counter is only done once the value is exactly zero
+		// so nothing touches it after a waiting thread could see it as done
+		static constexpr uint32 lock_bit = 0x80000000u;
+		std::atomic<uint32> m_value = 0;
+		detail::job_waiter* m_waiters = nullptr;
+	};
+
+	// a single unit of work
+	// the callable is stored inline so submitting a job does not allocate
+	struct alignas(64) job final {
+		// the max size of a callable that can be stored in a job
+		static constexpr size_t storage_size = 40;
+
+		using job_fn = void(*)(job*);
+
+	private:
+		friend job_system;
+		alignas(std::max_align_t) std::byte m_storage[storage_size];
+		std::atomic<job_fn> m_func = nullptr;
+		job_counter* m_counter = nullptr;
+		bool m_isHeap = false;
+	};
+
+	// static job system with one work stealing queue per worker thread
+	// the thread that calls start becomes worker 0 and helps execute jobs while waiting on counters
+	// idle workers go to sleep and are woken up when new jobs are submitted
+	class job_system final {
+		ALC_STATIC_CLASS(job_system);
+	public:
+
+		// starts the worker threads
+		// if threadCount is 0 then one thread less than the number of hardware threads is used
+		static void start(uint32 threadCount = 0);
+
+		// finishes every remaining job and joins the worker threads
+		static void stop();
+
+		// returns true if the job system was started
+		static bool is_running();
+
+		// returns the number of workers, including the thread that started the job system
+		static size_t get_worker_count();
+
+		// returns the index of the worker running on this thread or -1 if this is not a worker
+		static size_t get_worker_index();
+
+		// returns true on the thread that started the job system, or on any thread if it is not running
+		static bool is_main_thread();
+
+		// submits a callable to be run on any worker
+		// the callable must fit into job::storage_size
+		// runs immediately on this thread if the job system is not running
+		template<typename Fn> static void submit(Fn&& fn, job_counter* counter = nullptr);
+
+		// splits [0, count) into ranges of batchSize and calls fn(begin, end) for each in parallel
+		// returns once every range has finished
+		template<typename Fn> static void parallel_for(size_t count, size_t batchSize, Fn&& fn);
+
+		// runs jobs on this thread until the counter reaches zero
+		static void wait(job_counter* counter);
+
+	private:
+		static job* allocate_job();
+		static void submit_job(job* j);
+		static void execute(job* j);
+		static void resume_waiters(detail::job_waiter* waiter);
+
+		template<typename Fn>
+		static void invoke(job* j);
+
+	public:
+		// marks one more job of the counter as unfinished
+		static void __acquire(job_counter* counter);
+
+		// adds a coroutine to be resumed once the counter reaches zero
+		// returns false if the counter is already zero
+		static bool __add_waiter(job_counter* counter, detail::job_waiter* waiter);
+
+		// submits a job that resumes the coroutine, resumes it immediately if the job system isnt running
+		static void __resume(void* coroutine);
+
+		// marks one job of the counter as finished
+		static void __release(job_counter* counter);
+	};
+
+
+	// implementations
+
+	inline uint32 job_counter::get() const {
+		return m_value.load(std::memory_order_acquire) & ~lock_bit;
+	}
+
+	inline bool job_counter::is_done() const {
+		return m_value.load(std::memory_order_acquire) == 0;
+	}
+
+	inline void job_system::__acquire(job_counter* counter) {
+		counter->m_value.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template<typename Fn>
+	inline void job_system::invoke(job* j) {
+		Fn* fn = std::launder(reinterpret_cast<Fn*>(j->m_storage));
+		(*fn)();
+		fn->~Fn();
+	}
+
+	template<typename Fn>
+	inline void job_system::submit(Fn&& fn, job_counter* counter) {
+		using fn_t = std::decay_t<Fn>;
+		static_assert(sizeof(fn_t) <= job::storage_size, "callable is too large to be stored in a job");
+		static_assert(alignof(fn_t) <= alignof(std::max_align_t), "callable is over aligned");
+
+		if (!is_running()) {
+			fn();
+			return;
+		}
+
+		job* j = allocate_job();
+		new (j->m_storage) fn_t(std::forward<Fn>(fn));
+		j->m_counter = counter;
+		if (counter) __acquire(counter);
+		j->m_func.store(&invoke<fn_t>, std::memory_order_relaxed);
+		submit_job(j);
+	}
+
+	template<typename Fn>
+	inline void job_system::parallel_for(size_t count, size_t batchSize, Fn&& fn) {
+		if (batchSize == 0) batchSize = 1;
+
+		// not worth splitting
+		if (!is_running() || count <= batchSize) {
+			if (count > 0) fn(size_t(0), count);
+			return;
+		}
+
+		job_counter counter;
+		auto* func = &fn;
+		for (size_t begin = 0; begin < count; begin += batchSize) {
+			const size_t end = begin + batchSize < count ? begin + batchSize : count;
+			submit([func, begin, end]() { (*func)(begin, end); }, &counter);
+		}
+		wait(&counter);
+	}
+
+}
+
+#endif // !ALC_JOBS_JOB_SYSTEM_HPP
\ No newline at end of file
@@ -0,0 +1,179 @@
+#ifndef ALC_JOBS_JOB_TASK_HPP
+#define ALC_JOBS_JOB_TASK_HPP
+#include "job_system.hpp"
+#include <coroutine>
+#include <exception>
+
+namespace alc {
+
+	// a coroutine that runs on the job_system
+	// a task can co_await a job_counter, another job_task, or job_yield without blocking its worker,
+	// the worker moves on to other jobs and the task is resumed as a new job once it can continue
+	//     job_task load_level(level* lvl) {
+	//         job_counter counter;
+	//         for (auto& file : lvl->files)
+	//             job_system::submit([&file] { file.load(); }, &counter);
+	//         co_await counter;
+	//         lvl->build();
+	//     }
+	// tasks do not start until they are submitted or awaited
+	class job_task final {
+	public:
+		struct promise_type;
+		using handle_t = std::coroutine_handle<promise_type>;
+
+		job_task(job_task&& other) noexcept;
+		job_task& operator=(job_task&& other) noexcept;
+		~job_task();
+		ALC_NO_COPY(job_task);
+
+		// starts the task on the job system
+		// the counter is incremented now and decremented once the task finishes
+		void submit(job_counter* counter = nullptr);
+
+		// returns true if the task has not been submitted or awaited yet
+		bool is_valid() const;
+
+		// starts the task on this thread and resumes the awaiting coroutine when it finishes
+		auto operator co_await() && noexcept;
+
+		struct promise_type final {
+			std::coroutine_handle<> continuation;
+			job_counter* counter = nullptr;
+
+			job_task get_return_object() noexcept;
+			std::suspend_always initial_suspend() noexcept;
+			auto final_suspend() noexcept;
+			void return_void() noexcept;
+			void unhandled_exception() noexcept;
+		};
+
+	private:
+		handle_t m_handle;
+		explicit job_task(handle_t handle);
+	};
+
+	// suspends the task and queues it to be resumed as a new job
+	// lets other jobs run in between long running parts of a task
+	struct job_yield final {
+		bool await_ready() const noexcept;
+		void await_suspend(std::coroutine_handle<> handle) const;
+		void await_resume() const noexcept;
+	};
+
+	// waits for every job of the counter to finish without blocking the worker
+	auto operator co_await(job_counter& counter) noexcept;
+
+
+	// implementations
+
+	inline job_task::job_task(handle_t handle) : m_handle(handle) { }
+
+	inline job_task::job_task(job_task&& other) noexcept : m_handle(other.m_handle) {
+		other.m_handle = nullptr;
+	}
+
+	inline job_task& job_task::operator=(job_task&& other) noexcept {
+		if (this != &other) {
+			if (m_handle) m_handle.destroy();
+			m_handle = other.m_handle;
+			other.m_handle = nullptr;
+		}
+		return *this;
+	}
+
+	inline job_task::~job_task() {
+		// never started, nothing else owns the frame
+		if (m_handle) m_handle.destroy();
+	}
+
+	inline void job_task::submit(job_counter* counter) {
+		if (!m_handle) return;
+		handle_t handle = m_handle;
+		m_handle = nullptr;
+
+		// the frame destroys itself once finished
+		handle.promise().counter = counter;
+		if (counter) job_system::__acquire(counter);
+		job_system::__resume(handle.address());
+	}
+
+	inline bool job_task::is_valid() const {
+		return m_handle != nullptr;
+	}
+
+	inline auto job_task::operator co_await() && noexcept {
+		struct awaiter final {
+			handle_t handle;
+			bool await_ready() const noexcept { return !handle; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+				handle.promise().continuation = awaiting;
+				return handle;
+			}
+			void await_resume() const noexcept { }
+		};
+		handle_t handle = m_handle;
+		m_handle = nullptr;
+		return awaiter{ handle };
+	}
+
+	inline job_task job_task::promise_type::get_return_object() noexcept {
+		return job_task(handle_t::from_promise(*this));
+	}
+
+	inline std::suspend_always job_task::promise_type::initial_suspend() noexcept {
+		return { };
+	}
+
+	inline auto job_task::promise_type::final_suspend() noexcept {
+		struct final_awaiter final {
+			bool await_ready() const noexcept { return false; }
+			std::coroutine_handle<> await_suspend(handle_t handle) noexcept {
+				std::coroutine_handle<> continuation = handle.promise().continuation;
+				job_counter* counter = handle.promise().counter;
+				handle.destroy();
+
+				if (counter) job_system::__release(counter);
+
+				// continue the awaiting task on this thread
+				if (continuation) return continuation;
+				return std::noop_coroutine();
+			}
+			void await_resume() const noexcept { }
+		};
+		return final_awaiter{ };
+	}
+
+	inline void job_task::promise_type::return_void() noexcept { }
+
+	inline void job_task::promise_type::unhandled_exception() noexcept {
+		std::terminate();
+	}
+
+	inline bool job_yield::await_ready() const noexcept {
+		return !job_system::is_running();
+	}
+
+	inline void job_yield::await_suspend(std::coroutine_handle<> handle) const {
+		job_system::__resume(handle.address());
+	}
+
+	inline void job_yield::await_resume() const noexcept { }
+
+	inline auto operator co_await(job_counter& counter) noexcept {
+		struct awaiter final {
+			job_counter& counter;
+			detail::job_waiter waiter;
+			bool await_ready() const noexcept { return counter.is_done(); }
+			bool await_suspend(std::coroutine_handle<> handle) noexcept {
+				waiter.coroutine = handle.address();
+				return job_system::__add_waiter(&counter, &waiter);
+			}
+			void await_resume() const noexcept { }
+		};
+		return awaiter{ counter, { } };
+	}
+
+}
+
+#endif // !ALC_JOBS_JOB_TASK_HPP
\ No newline at end of file
@@ -1,32 +1,83 @@
 #ifndef ALC_REFLECTION_TYPEHASH_HPP
 #define ALC_REFLECTION_TYPEHASH_HPP
 #include "../common.hpp"
+#include "../datatypes/hash.hpp"
+#include <atomic>
+#include <string_view>
+#include <type_traits>
 
 namespace alc {
 
-	namespace detail { uint32 type_counter(); }
+	namespace detail { std::atomic<uint32>& type_counter(); }
 
 	// represents a type
+	// values are dense (starting at 0) so they can be used to index into arrays
+	// values are assigned at runtime the first time a type is used and may differ between runs,
+	// use get_type_key for a value known at compile time
 	enum class typehash : uint32 { };
 
 	// returns the typehash for the specific type
-	// garunteed unique for every type
+	// garunteed unique for every type, cv and reference qualifiers are ignored
 	template<typename T>
 	typehash get_typehash();
 
+	// returns the number of typehashes that have been assigned so far
+	uint32 typehash_count();
+
+	// returns a key for the type computed at compile time by hashing its name
+	// it is the same in every run of a build so it can be saved, but it is not dense
+	// and the name it is made from differs between compilers
+	template<typename T>
+	constexpr hash64_t get_type_key();
+
 	// implementations
 
 	namespace detail {
-		inline uint32 type_counter() {
-			uint32 counter = 0;
-			return counter++;
+		inline std::atomic<uint32>& type_counter() {
+			static std::atomic<uint32> counter = 0;
+			return counter;
+		}
+
+		template<typename T>
+		inline typehash typehash_of() {
+			static const typehash tyhash = static_cast<typehash>(type_counter().fetch_add(1));
+			return tyhash;
+		}
+
+		template<typename T>
+		constexpr std::string_view raw_typename() {
+			#if defined(_MSC_VER)
+			return __FUNCSIG__;
+			#else
+			return __PRETTY_FUNCTION__;
+			#endif
+		}
+
+		// the raw name of a known type, used to find where the type appears in the signature
+		constexpr std::string_view raw_typename_probe = raw_typename<double>();
+		constexpr size_t typename_prefix = raw_typename_probe.find("double");
+		constexpr size_t typename_suffix = raw_typename_probe.size() - typename_prefix - std::string_view("double").size();
+
+		// returns the name of the type as written by the compiler, used for profiling labels
+		template<typename T>
+		inline constexpr std::string_view get_typename() {
+			constexpr std::string_view raw = raw_typename<T>();
+			return raw.substr(typename_prefix, raw.size() - typename_prefix - typename_suffix);
 		}
 	}
 
 	template<typename T>
 	inline typehash get_typehash() {
-		const typehash tyhash = static_cast<typehash>(detail::type_counter());
-		return tyhash;
+		return detail::typehash_of<std::remove_cv_t<std::remove_reference_t<T>>>();
+	}
+
+	inline uint32 typehash_count() {
+		return detail::type_counter().load();
+	}
+
+	template<typename T>
+	inline constexpr hash64_t get_type_key() {
+		return hash_string<hash64_t>(detail::get_typename<std::remove_cv_t<std::remove_reference_t<T>>>());
 	}
 
 }